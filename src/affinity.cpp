@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "affinity.hpp"
+
+#include <mutex>
+#include <thread>
+#include <cassert>
+#include <utility>
+#include <unordered_map>
+
+namespace sqlite {
+
+namespace detail {
+
+#ifndef NDEBUG
+
+namespace {
+
+std::mutex owners_mutex;
+std::unordered_map<sqlite3 *, std::thread::id> owners;
+
+}   // namespace
+
+void claim_connection(sqlite3 *db) {
+    std::lock_guard<std::mutex> lock(owners_mutex);
+    owners[db] = std::this_thread::get_id();
+}
+
+void release_connection(sqlite3 *db) {
+    std::lock_guard<std::mutex> lock(owners_mutex);
+    owners.erase(db);
+}
+
+std::thread::id hand_over_connection(sqlite3 *db, std::thread::id owner) {
+    std::lock_guard<std::mutex> lock(owners_mutex);
+    auto found(owners.find(db));
+    if (found == owners.end())
+        return {};
+    std::swap(found->second, owner);
+    return owner;
+}
+
+void check_affinity(sqlite3 *db) {
+    std::lock_guard<std::mutex> lock(owners_mutex);
+    auto owner(owners.find(db));
+    assert(
+        (owner == owners.end() || owner->second == std::this_thread::get_id()) &&
+        "multi_thread sqlite::database used from a thread that does not own it"
+    );
+    (void) owner;
+}
+
+#endif
+
+} // namespace detail
+
+} // namespace sqlite
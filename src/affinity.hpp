@@ -0,0 +1,51 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_AFFINITY_H
+#define SQLITE_AFFINITY_H
+
+#include <thread>
+
+struct sqlite3;
+
+namespace sqlite {
+
+namespace detail {
+
+// Debug builds remember which thread owns each multi_thread connection and
+// assert when another thread uses it, release builds compile this away.
+// hand_over_connection passes an owned connection to another thread and
+// returns the previous owner, connections without one are left alone.
+#ifdef NDEBUG
+inline void claim_connection(sqlite3 *) {}
+inline void release_connection(sqlite3 *) {}
+inline void check_affinity(sqlite3 *) {}
+inline std::thread::id hand_over_connection(sqlite3 *, std::thread::id) {
+    return {};
+}
+#else
+void claim_connection(sqlite3 *db);
+void release_connection(sqlite3 *db);
+void check_affinity(sqlite3 *db);
+std::thread::id hand_over_connection(sqlite3 *db, std::thread::id owner);
+#endif
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_AFFINITY_H
@@ -0,0 +1,242 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "bloom.hpp"
+#include "database.hpp"
+#include "error.hpp"
+#include "expected.hpp"
+
+#include <sqlite3.h>
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 33);
+}
+
+uint64_t hash_bytes(const char &tag, const char *data, const std::size_t &size) {
+    uint64_t hash(14695981039346656037ull);
+    hash = (hash ^ static_cast<unsigned char>(tag)) * 1099511628211ull;
+    for (std::size_t i(0); i < size; ++i)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    return mix(hash);
+}
+
+uint64_t hash_integer(const int64_t &integer) {
+    return mix(static_cast<uint64_t>(integer) ^ 0x9e3779b97f4a7c15ull);
+}
+
+void step_or_raise(const std::shared_ptr<sqlite3_stmt> &stmt, const int &status) {
+    if (status != SQLITE_ROW && status != SQLITE_DONE) {
+        (void) sqlite3_reset(stmt.get());
+        error_code(status, stmt).raise();
+    }
+}
+
+}
+
+bloom_filter::bloom_filter(
+        const std::size_t &expected_keys,
+        const double &false_positive_rate
+) {
+    assert(
+        false_positive_rate > 0.0 && false_positive_rate < 1.0 &&
+        "bloom_filter false positive rate must be between 0 and 1"
+    );
+    const double ln2(std::log(2.0));
+    double keys(std::max<std::size_t>(expected_keys, 1));
+    double ideal_bits(-keys * std::log(false_positive_rate) / (ln2 * ln2));
+    // A power of two number of bits lets positions be masked out of the hash
+    std::size_t words(1);
+    while (words * 64 < ideal_bits)
+        words <<= 1;
+    bits.assign(words, 0);
+    mask = words * 64 - 1;
+    hashes = std::min(16, std::max(1, static_cast<int>(
+        std::lround(double(words * 64) / keys * ln2)
+    )));
+}
+
+void bloom_filter::insert_hash(const uint64_t &key_hash) {
+    // Double hashing derives every probe position from one 64 bit hash
+    uint64_t position(key_hash), step((key_hash >> 32) | 1);
+    for (int i(0); i < hashes; ++i, position += step)
+        bits[(position & mask) >> 6] |= uint64_t(1) << (position & 63);
+}
+
+bool bloom_filter::may_contain_hash(const uint64_t &key_hash) const {
+    uint64_t position(key_hash), step((key_hash >> 32) | 1);
+    for (int i(0); i < hashes; ++i, position += step) {
+        if (! (bits[(position & mask) >> 6] & uint64_t(1) << (position & 63)))
+            return false;
+    }
+    return true;
+}
+
+uint64_t bloom_filter::hash(const value &key) {
+    switch (key.type()) {
+    case value_type::integer:
+        return hash_integer(key.as<int64_t>());
+    case value_type::real: {
+        double real(key.as<double>());
+        // Matches sqlite, where 3.0 = 3
+        if (std::trunc(real) == real &&
+                real >= -9223372036854775808.0 && real < 9223372036854775808.0)
+            return hash_integer(static_cast<int64_t>(real));
+        char bytes[sizeof(real)];
+        std::memcpy(bytes, &real, sizeof(real));
+        return hash_bytes('r', bytes, sizeof(bytes));
+    }
+    case value_type::text:
+        return hash_bytes('t', key.data(), key.size());
+    case value_type::blob:
+        return hash_bytes('b', key.data(), key.size());
+    default:
+        return 0;
+    }
+}
+
+namespace detail {
+
+existence_filter::existence_filter(
+        database &db,
+        const std::string &table,
+        const std::string &column,
+        const existence_options &options
+):
+    options(options),
+    connection(db.db),
+    changes(std::make_shared<change_queue>(options.change_capacity)) {
+    auto name(detail::quote_identifier(table)), key(detail::quote_identifier(column));
+    scan = db.create_statement("SELECT " + key + " FROM " + name + ";");
+    // Fails for WITHOUT ROWID tables, which the update hook doesn't report
+    lookup = db.create_statement(
+        "SELECT " + key + " FROM " + name + " WHERE rowid = ?;"
+    );
+    version = db.create_statement("PRAGMA data_version;");
+    if (! db.changes) {
+        db.changes = std::make_shared<change_hub>();
+        db.changes->attach(db.db);
+    }
+    db.changes->observe(changes, table);
+    catch_up();
+}
+
+bool existence_filter::may_contain(const value &key) {
+    catch_up();
+    // Until it can be rebuilt every key may be there
+    return stale || filter->may_contain(key);
+}
+
+void existence_filter::catch_up() {
+    bool in_transaction(sqlite3_get_autocommit(connection) == 0);
+    if (! stale && external_writes())
+        stale = true;
+    if (changes->dropped() != dropped)
+        stale = true;
+    if (stale) {
+        if (! in_transaction)
+            rebuild();
+        return;
+    }
+    change next;
+    while (changes->pop(next)) {
+        if (next.operation == change_operation::remove) {
+            ++removed;
+            continue;
+        }
+        (void) sqlite3_bind_int64(lookup.get(), 1, next.rowid);
+        auto status(sqlite3_step(lookup.get()));
+        if (status == SQLITE_ROW) {
+            value key;
+            key.assign_column(lookup.get(), 0);
+            if (! key.is_null()) {
+                filter->insert(key);
+                ++keys;
+            }
+        }
+        (void) sqlite3_reset(lookup.get());
+        step_or_raise(lookup, status);
+    }
+    // Deleted keys linger and added ones crowd the filter, either way the
+    // false positive rate drifts from the one asked for
+    if ((keys > capacity || removed > capacity / 2) && ! in_transaction)
+        rebuild();
+}
+
+void existence_filter::rebuild() {
+    if (options.track_external_writes) {
+        last_version = data_version();
+        last_check = std::chrono::steady_clock::now();
+    }
+    // Changes made while scanning are already in the table
+    change discarded;
+    while (changes->pop(discarded)) {}
+    dropped = changes->dropped();
+    std::vector<uint64_t> hashes;
+    int status;
+    while ((status = sqlite3_step(scan.get())) == SQLITE_ROW) {
+        value key;
+        key.assign_column(scan.get(), 0);
+        if (! key.is_null())
+            hashes.push_back(bloom_filter::hash(key));
+    }
+    (void) sqlite3_reset(scan.get());
+    step_or_raise(scan, status);
+    capacity = std::max(options.expected_keys, hashes.size() + hashes.size() / 2 + 1024);
+    filter.reset(new bloom_filter(capacity, options.false_positive_rate));
+    for (const uint64_t &key_hash : hashes)
+        filter->insert_hash(key_hash);
+    keys = hashes.size();
+    removed = 0;
+    stale = false;
+    ++rebuild_count;
+}
+
+bool existence_filter::external_writes() {
+    if (! options.track_external_writes)
+        return false;
+    // Stepping the pragma costs most of the indexed lookup it saves
+    auto now(std::chrono::steady_clock::now());
+    if (now - last_check < options.external_check_interval)
+        return false;
+    last_check = now;
+    return data_version() != last_version;
+}
+
+int64_t existence_filter::data_version() {
+    auto status(sqlite3_step(version.get()));
+    int64_t current(sqlite3_column_int64(version.get(), 0));
+    (void) sqlite3_reset(version.get());
+    step_or_raise(version, status);
+    return current;
+}
+
+} // namespace detail
+
+} // namespace sqlite
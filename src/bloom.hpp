@@ -0,0 +1,127 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_BLOOM_H
+#define SQLITE_BLOOM_H
+
+#include "value.hpp"
+#include "change_feed.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct sqlite3_stmt;
+
+namespace sqlite {
+
+class database;
+
+// Keys hash by their value, so probes must use the column's own type:
+// integers and integral reals hash alike, text and blobs never match
+class bloom_filter {
+public:
+    bloom_filter(
+            const std::size_t &expected_keys,
+            const double &false_positive_rate = 0.01
+    );
+
+    void insert(const value &key) { insert_hash(hash(key)); }
+    bool may_contain(const value &key) const {
+        return ! key.is_null() && may_contain_hash(hash(key));
+    }
+
+    void insert_hash(const uint64_t &key_hash);
+    bool may_contain_hash(const uint64_t &key_hash) const;
+
+    std::size_t size_bytes() const { return bits.size() * sizeof(uint64_t); }
+    int hash_count() const { return hashes; }
+
+    static uint64_t hash(const value &key);
+
+private:
+    std::vector<uint64_t> bits;
+    uint64_t mask;
+    int hashes;
+};
+
+struct existence_options {
+    // Zero sizes the filter from the table when it is built
+    std::size_t expected_keys = 0;
+    double false_positive_rate = 0.01;
+    // Checks PRAGMA data_version so commits by other connections trigger a
+    // rebuild, at most once per interval, turn off when this is the only
+    // writer. Zero checks on every probe.
+    bool track_external_writes = true;
+    std::chrono::milliseconds external_check_interval = std::chrono::milliseconds(10);
+    std::size_t change_capacity = 65536;
+};
+
+namespace detail {
+
+// A bloom filter over one column, built by a scan and kept current from the
+// change hub. Inserted and updated rows are looked up by rowid before the
+// next probe, deletes can't be removed so enough of them trigger a rebuild.
+// Rebuilds wait for the connection to leave its transaction, a rollback could
+// restore rows the scan didn't see and sqlite reports no changes for it.
+class existence_filter {
+public:
+    existence_filter(
+            database &db,
+            const std::string &table,
+            const std::string &column,
+            const existence_options &options
+    );
+    existence_filter(const existence_filter &other) = delete;
+
+    existence_filter& operator=(const existence_filter &other) = delete;
+
+    bool may_contain(const value &key);
+    std::size_t rebuilds() const { return rebuild_count; }
+
+private:
+    void catch_up();
+    void rebuild();
+    bool external_writes();
+    int64_t data_version();
+
+private:
+    const existence_options options;
+    sqlite3 *connection;
+    std::shared_ptr<sqlite3_stmt> scan;
+    std::shared_ptr<sqlite3_stmt> lookup;
+    std::shared_ptr<sqlite3_stmt> version;
+    std::shared_ptr<change_queue> changes;
+    std::unique_ptr<bloom_filter> filter;
+    std::size_t keys = 0;
+    std::size_t capacity = 0;
+    std::size_t removed = 0;
+    std::size_t dropped = 0;
+    int64_t last_version = 0;
+    std::chrono::steady_clock::time_point last_check;
+    std::size_t rebuild_count = 0;
+    bool stale = true;
+};
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_BLOOM_H
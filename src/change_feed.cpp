@@ -0,0 +1,192 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "change_feed.hpp"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+std::size_t ring_capacity(const std::size_t &depth) {
+    std::size_t capacity(2);
+    while (capacity < depth)
+        capacity <<= 1;
+    return capacity;
+}
+
+change_operation operation_of(const int &operation) {
+    switch (operation) {
+    case SQLITE_INSERT: return change_operation::insert;
+    case SQLITE_DELETE: return change_operation::remove;
+    default:            return change_operation::update;
+    }
+}
+
+}   // namespace
+
+namespace detail {
+
+change_queue::change_queue(const std::size_t &capacity):
+    ring(ring_capacity(capacity)),
+    mask(ring.size() - 1),
+    head(0),
+    tail(0),
+    dropped_changes(0) {}
+
+bool change_queue::publish(const std::vector<change> &transaction) {
+    std::size_t next(tail.load(std::memory_order_relaxed));
+    std::size_t free(ring.size() - (next - head.load(std::memory_order_acquire)));
+    if (transaction.size() > free) {
+        // Never wait for a slow subscriber, whole transactions are dropped
+        dropped_changes.fetch_add(transaction.size(), std::memory_order_relaxed);
+        return false;
+    }
+    for (const change &item : transaction)
+        ring[next++ & mask] = item;
+    tail.store(next, std::memory_order_release);
+    return true;
+}
+
+bool change_queue::push(const change &item) {
+    std::size_t next(tail.load(std::memory_order_relaxed));
+    if (next - head.load(std::memory_order_acquire) == ring.size()) {
+        dropped_changes.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ring[next & mask] = item;
+    tail.store(next + 1, std::memory_order_release);
+    return true;
+}
+
+bool change_queue::pop(change &next) {
+    std::size_t current(head.load(std::memory_order_relaxed));
+    if (current == tail.load(std::memory_order_acquire))
+        return false;
+    next = std::move(ring[current & mask]);
+    head.store(current + 1, std::memory_order_release);
+    return true;
+}
+
+std::size_t change_queue::dropped() const {
+    return dropped_changes.load(std::memory_order_relaxed);
+}
+
+void change_hub::attach(sqlite3 *db) {
+    (void) sqlite3_update_hook(db, &change_hub::on_update, this);
+    (void) sqlite3_commit_hook(db, &change_hub::on_commit, this);
+    (void) sqlite3_rollback_hook(db, &change_hub::on_rollback, this);
+}
+
+void change_hub::add(const std::shared_ptr<change_queue> &subscriber) {
+    subscribers.push_back(subscriber);
+}
+
+void change_hub::observe(
+        const std::shared_ptr<change_queue> &observer,
+        const std::string &table
+) {
+    observers.push_back(table_observer{observer, table});
+}
+
+void change_hub::on_update(
+        void *context,
+        int operation,
+        const char *database,
+        const char *table,
+        long long rowid
+) {
+    auto hub(static_cast<change_hub *>(context));
+    try {
+        change item;
+        item.operation = operation_of(operation);
+        item.database = database;
+        item.table = table;
+        item.rowid = rowid;
+        for (const table_observer &observer : hub->observers) {
+            if (sqlite3_stricmp(observer.table.c_str(), table) != 0)
+                continue;
+            if (auto queue = observer.queue.lock())
+                (void) queue->push(item);
+        }
+        hub->pending.push_back(std::move(item));
+    } catch (...) {
+        // Can't throw through sqlite
+    }
+}
+
+int change_hub::on_commit(void *context) {
+    auto hub(static_cast<change_hub *>(context));
+    if (! hub->pending.empty()) {
+        for (const std::weak_ptr<change_queue> &subscriber : hub->subscribers) {
+            if (auto queue = subscriber.lock())
+                (void) queue->publish(hub->pending);
+        }
+        hub->pending.clear();
+    }
+    hub->subscribers.erase(
+        std::remove_if(
+            hub->subscribers.begin(), hub->subscribers.end(),
+            [](const std::weak_ptr<change_queue> &subscriber) {
+                return subscriber.expired();
+            }
+        ), hub->subscribers.end()
+    );
+    hub->observers.erase(
+        std::remove_if(
+            hub->observers.begin(), hub->observers.end(),
+            [](const table_observer &observer) {
+                return observer.queue.expired();
+            }
+        ), hub->observers.end()
+    );
+    return 0;
+}
+
+void change_hub::on_rollback(void *context) {
+    static_cast<change_hub *>(context)->pending.clear();
+}
+
+} // namespace detail
+
+change_subscription::change_subscription(
+        const std::shared_ptr<detail::change_queue> &queue
+):
+    queue(queue) {}
+
+bool change_subscription::poll(change &next) {
+    return queue->pop(next);
+}
+
+std::size_t change_subscription::drain(std::vector<change> &changes) {
+    std::size_t count(0);
+    change next;
+    while (queue->pop(next)) {
+        changes.push_back(std::move(next));
+        ++count;
+    }
+    return count;
+}
+
+std::size_t change_subscription::dropped() const {
+    return queue->dropped();
+}
+
+} // namespace sqlite
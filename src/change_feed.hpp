@@ -0,0 +1,120 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_CHANGE_FEED_H
+#define SQLITE_CHANGE_FEED_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct sqlite3;
+
+namespace sqlite {
+
+enum class change_operation {
+    insert,
+    update,
+    remove
+};
+
+struct change {
+    change_operation operation = change_operation::insert;
+    std::string database;
+    std::string table;
+    int64_t rowid = 0;
+};
+
+namespace detail {
+
+class change_queue {
+public:
+    explicit change_queue(const std::size_t &capacity);
+    change_queue(const change_queue &other) = delete;
+
+    change_queue& operator=(const change_queue &other) = delete;
+
+    bool publish(const std::vector<change> &transaction);
+    bool push(const change &item);
+    bool pop(change &next);
+    std::size_t dropped() const;
+
+private:
+    std::vector<change> ring;
+    const std::size_t mask;
+    std::atomic<std::size_t> head;
+    std::atomic<std::size_t> tail;
+    std::atomic<std::size_t> dropped_changes;
+};
+
+class change_hub {
+public:
+    change_hub() = default;
+    change_hub(const change_hub &other) = delete;
+
+    change_hub& operator=(const change_hub &other) = delete;
+
+    void attach(sqlite3 *db);
+    void add(const std::shared_ptr<change_queue> &subscriber);
+    // Observers see each change to one table as it happens, before commit
+    void observe(
+            const std::shared_ptr<change_queue> &observer,
+            const std::string &table
+    );
+
+private:
+    static void on_update(
+            void *context,
+            int operation,
+            const char *database,
+            const char *table,
+            long long rowid
+    );
+    static int on_commit(void *context);
+    static void on_rollback(void *context);
+
+private:
+    struct table_observer {
+        std::weak_ptr<change_queue> queue;
+        std::string table;
+    };
+
+    std::vector<change> pending;
+    std::vector<std::weak_ptr<change_queue>> subscribers;
+    std::vector<table_observer> observers;
+};
+
+} // namespace detail
+
+class change_subscription {
+public:
+    explicit change_subscription(const std::shared_ptr<detail::change_queue> &queue);
+
+    bool poll(change &next);
+    std::size_t drain(std::vector<change> &changes);
+    std::size_t dropped() const;
+
+private:
+    std::shared_ptr<detail::change_queue> queue;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_CHANGE_FEED_H
@@ -0,0 +1,188 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "checkpoint.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+std::string database_path(sqlite3 *db) {
+    const char *path(sqlite3_db_filename(db, "main"));
+    if (! path || ! *path)
+        throw error("checkpoint_manager requires a file backed database");
+    return path;
+}
+
+std::chrono::steady_clock::rep now() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+}
+
+checkpoint_manager::checkpoint_manager(
+        database &db,
+        const checkpoint_policy &policy
+):
+    writer(db.db),
+    autocheckpoint(db.execute_scalar<int>("PRAGMA wal_autocheckpoint;")),
+    checkpointer(database_path(db.db), read_write),
+    policy(policy),
+    wal_frames(0),
+    backfilled(0),
+    dirty(false),
+    requested(false),
+    last_commit(now()) {
+    if (checkpointer.execute_scalar<std::string>("PRAGMA journal_mode;") != "wal")
+        throw error("checkpoint_manager requires a database in WAL mode");
+    (void) sqlite3_wal_autocheckpoint(writer, 0);
+    (void) sqlite3_wal_hook(writer, &checkpoint_manager::on_commit, this);
+    worker = std::thread(&checkpoint_manager::run, this);
+}
+
+checkpoint_manager::~checkpoint_manager() {
+    // Replaces our wal hook with the automatic checkpointing it displaced
+    (void) sqlite3_wal_autocheckpoint(writer, autocheckpoint);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void checkpoint_manager::request_checkpoint() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requested.store(true, std::memory_order_release);
+    }
+    wake.notify_one();
+}
+
+checkpoint_statistics checkpoint_manager::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+int checkpoint_manager::on_commit(
+        void *context,
+        sqlite3 *,
+        const char *,
+        int frames
+) {
+    auto manager(static_cast<checkpoint_manager *>(context));
+    manager->wal_frames.store(frames, std::memory_order_relaxed);
+    manager->last_commit.store(now(), std::memory_order_relaxed);
+    manager->dirty.store(true, std::memory_order_release);
+    if (manager->pending_frames() >= manager->policy.frame_threshold)
+        manager->wake.notify_one();
+    return SQLITE_OK;
+}
+
+void checkpoint_manager::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (! stopping) {
+        wake.wait_for(lock, policy.idle_time, [this] {
+            return stopping || requested.load(std::memory_order_acquire)
+                || (dirty.load(std::memory_order_acquire)
+                    && pending_frames() >= policy.frame_threshold);
+        });
+        if (stopping || ! checkpoint_due())
+            continue;
+        std::size_t frames(wal_frames.load(std::memory_order_relaxed));
+        dirty.store(false, std::memory_order_relaxed);
+        requested.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        bool progressed(checkpoint(frames));
+        lock.lock();
+        if (progressed)
+            continue;
+        // Retry a blocked or partial checkpoint once readers had time to move on
+        dirty.store(true, std::memory_order_relaxed);
+        wake.wait_for(lock, policy.idle_time, [this] {
+            return stopping || requested.load(std::memory_order_acquire);
+        });
+    }
+}
+
+std::size_t checkpoint_manager::pending_frames() const {
+    // Frames already copied back stay in the wal until a writer restarts it
+    std::size_t frames(wal_frames.load(std::memory_order_relaxed));
+    std::size_t copied(backfilled.load(std::memory_order_relaxed));
+    return frames >= copied ? frames - copied : frames;
+}
+
+bool checkpoint_manager::checkpoint_due() const {
+    if (requested.load(std::memory_order_acquire))
+        return true;
+    if (! dirty.load(std::memory_order_acquire))
+        return false;
+    if (pending_frames() >= policy.frame_threshold)
+        return true;
+    std::chrono::steady_clock::duration idle(
+        now() - last_commit.load(std::memory_order_relaxed)
+    );
+    return idle >= policy.idle_time;
+}
+
+bool checkpoint_manager::checkpoint(const std::size_t &frames) {
+    int mode(SQLITE_CHECKPOINT_PASSIVE);
+    if (frames >= policy.truncate_threshold)
+        mode = SQLITE_CHECKPOINT_TRUNCATE;
+    else if (frames >= policy.restart_threshold)
+        mode = SQLITE_CHECKPOINT_RESTART;
+
+    auto started(std::chrono::steady_clock::now());
+    int log_frames(0);
+    int checkpointed_frames(0);
+    auto status(sqlite3_wal_checkpoint_v2(
+        checkpointer.db, nullptr, mode, &log_frames, &checkpointed_frames
+    ));
+    auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started
+    ));
+
+    bool restarted(status == SQLITE_OK && mode != SQLITE_CHECKPOINT_PASSIVE);
+    // A restarted wal starts over at frame zero unless a commit beat us to it
+    std::size_t expected(frames);
+    if (restarted && wal_frames.compare_exchange_strong(expected, 0))
+        backfilled.store(0, std::memory_order_relaxed);
+    else
+        backfilled.store(std::max(checkpointed_frames, 0), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (status == SQLITE_BUSY)
+        ++stats.busy;
+    else if (status != SQLITE_OK)
+        return false;
+    else if (mode == SQLITE_CHECKPOINT_TRUNCATE)
+        ++stats.truncate;
+    else if (mode == SQLITE_CHECKPOINT_RESTART)
+        ++stats.restart;
+    else
+        ++stats.passive;
+    stats.frames_checkpointed += std::max(checkpointed_frames, 0);
+    stats.last_wal_frames = std::max(log_frames, 0);
+    stats.total_duration += elapsed;
+    stats.max_duration = std::max(stats.max_duration, elapsed);
+    return status == SQLITE_OK && checkpointed_frames >= log_frames;
+}
+
+} // namespace sqlite
@@ -0,0 +1,93 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_CHECKPOINT_H
+#define SQLITE_CHECKPOINT_H
+
+#include "database.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstddef>
+#include <condition_variable>
+
+struct sqlite3;
+
+namespace sqlite {
+
+struct checkpoint_policy {
+    std::size_t frame_threshold = 1000;
+    std::size_t restart_threshold = 10000;
+    std::size_t truncate_threshold = 50000;
+    std::chrono::milliseconds idle_time = std::chrono::milliseconds(250);
+};
+
+struct checkpoint_statistics {
+    std::size_t passive = 0;
+    std::size_t restart = 0;
+    std::size_t truncate = 0;
+    std::size_t busy = 0;
+    std::size_t frames_checkpointed = 0;
+    std::size_t last_wal_frames = 0;
+    std::chrono::microseconds total_duration = std::chrono::microseconds(0);
+    std::chrono::microseconds max_duration = std::chrono::microseconds(0);
+
+    std::size_t checkpoints() const { return passive + restart + truncate; }
+};
+
+class checkpoint_manager {
+public:
+    checkpoint_manager(
+            database &db,
+            const checkpoint_policy &policy = checkpoint_policy()
+    );
+    checkpoint_manager(const checkpoint_manager &other) = delete;
+    ~checkpoint_manager();
+
+    checkpoint_manager& operator=(const checkpoint_manager &other) = delete;
+
+    void request_checkpoint();
+    checkpoint_statistics statistics() const;
+
+private:
+    static int on_commit(void *context, sqlite3 *db, const char *, int frames);
+    void run();
+    std::size_t pending_frames() const;
+    bool checkpoint_due() const;
+    bool checkpoint(const std::size_t &frames);
+
+private:
+    sqlite3 *writer;
+    int autocheckpoint;
+    database checkpointer;
+    const checkpoint_policy policy;
+    std::atomic<std::size_t> wal_frames;
+    std::atomic<std::size_t> backfilled;
+    std::atomic<bool> dirty;
+    std::atomic<bool> requested;
+    std::atomic<std::chrono::steady_clock::rep> last_commit;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    checkpoint_statistics stats;
+    std::thread worker;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_CHECKPOINT_H
@@ -0,0 +1,428 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "codec.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+const int hash_bits = 12;
+const std::size_t minimum_match = 4;
+const std::size_t max_offset = 65535;
+// Matches stop short of the end so the final bytes are always literals
+const std::size_t end_literals = 5;
+const std::size_t match_margin = 12;
+
+const unsigned char frame_marker = 0xc0;
+const unsigned char frame_compressed = 0x01;
+const unsigned char frame_text = 0x02;
+
+uint32_t read32(const unsigned char *data) {
+    uint32_t word;
+    std::memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+void write_length(std::string &output, std::size_t length) {
+    while (length >= 255) {
+        output += static_cast<char>(255);
+        length -= 255;
+    }
+    output += static_cast<char>(length);
+}
+
+std::size_t read_length(
+        const unsigned char *input,
+        std::size_t &offset,
+        const std::size_t &size
+) {
+    std::size_t length(0);
+    unsigned char byte;
+    do {
+        if (offset >= size)
+            throw error(SQLITE_CORRUPT, "truncated lz length");
+        byte = input[offset++];
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+void write_sequence(
+        std::string &output,
+        const unsigned char *literals,
+        const std::size_t &literal_count,
+        const std::size_t &offset,
+        const std::size_t &match_length
+) {
+    std::size_t extra_match(match_length ? match_length - minimum_match : 0);
+    output += static_cast<char>(
+        std::min<std::size_t>(literal_count, 15) << 4 |
+        std::min<std::size_t>(extra_match, 15)
+    );
+    if (literal_count >= 15)
+        write_length(output, literal_count - 15);
+    output.append(reinterpret_cast<const char *>(literals), literal_count);
+    if (! match_length)
+        return;
+    output += static_cast<char>(offset & 0xff);
+    output += static_cast<char>(offset >> 8);
+    if (extra_match >= 15)
+        write_length(output, extra_match - 15);
+}
+
+// An LZ4 style block format: each sequence is a token holding the literal
+// and match lengths, the literals, then a two byte offset back to the match
+class lz: public codec {
+public:
+    const char* name() const override { return "lz"; }
+
+    void compress(
+            const char *data,
+            const std::size_t &size,
+            std::string &output
+    ) const override {
+        auto input(reinterpret_cast<const unsigned char *>(data));
+        output.clear();
+        output.reserve(size + size / 255 + 16);
+        uint32_t table[1 << hash_bits] = {};
+        std::size_t anchor(0), position(0);
+        if (size > match_margin) {
+            std::size_t limit(size - match_margin);
+            while (position < limit) {
+                uint32_t sequence(read32(input + position));
+                uint32_t hash((sequence * 2654435761u) >> (32 - hash_bits));
+                std::size_t candidate(table[hash]);
+                table[hash] = position + 1;
+                if (! candidate || position - (candidate - 1) > max_offset ||
+                        read32(input + candidate - 1) != sequence) {
+                    ++position;
+                    continue;
+                }
+                std::size_t match(candidate - 1), length(minimum_match);
+                while (position + length < size - end_literals &&
+                        input[match + length] == input[position + length])
+                    ++length;
+                write_sequence(
+                    output, input + anchor, position - anchor,
+                    position - match, length
+                );
+                position += length;
+                anchor = position;
+            }
+        }
+        write_sequence(output, input + anchor, size - anchor, 0, 0);
+    }
+
+    void decompress(
+            const char *data,
+            const std::size_t &size,
+            const std::size_t &original_size,
+            std::string &output
+    ) const override {
+        auto input(reinterpret_cast<const unsigned char *>(data));
+        // No sequence expands to more than 255 bytes per input byte
+        if (original_size / 255 > size + 1)
+            throw error(SQLITE_CORRUPT, "lz output length out of range");
+        output.resize(original_size);
+        char *out(&output[0]);
+        std::size_t in(0), written(0);
+        while (in < size) {
+            unsigned char token(input[in++]);
+            std::size_t literals(token >> 4);
+            if (literals == 15)
+                literals += read_length(input, in, size);
+            if (literals > size - in || literals > original_size - written)
+                throw error(SQLITE_CORRUPT, "lz literals overrun");
+            std::memcpy(out + written, input + in, literals);
+            in += literals;
+            written += literals;
+            if (in == size)
+                break;
+            if (size - in < 2)
+                throw error(SQLITE_CORRUPT, "truncated lz offset");
+            std::size_t offset(input[in] | input[in + 1] << 8);
+            in += 2;
+            std::size_t length(token & 0x0f);
+            if (length == 15)
+                length += read_length(input, in, size);
+            length += minimum_match;
+            if (! offset || offset > written || length > original_size - written)
+                throw error(SQLITE_CORRUPT, "lz match out of range");
+            // Matches may overlap the bytes they produce
+            const char *match(out + written - offset);
+            for (std::size_t i(0); i < length; ++i)
+                out[written + i] = match[i];
+            written += length;
+        }
+        if (written != original_size)
+            throw error(SQLITE_CORRUPT, "lz output shorter than recorded");
+    }
+};
+
+void put_varint(std::string &output, uint64_t number) {
+    while (number >= 0x80) {
+        output += static_cast<char>(number | 0x80);
+        number >>= 7;
+    }
+    output += static_cast<char>(number);
+}
+
+uint64_t get_varint(const unsigned char *input, std::size_t &offset, const std::size_t &size) {
+    uint64_t number(0);
+    for (int shift(0); shift < 64; shift += 7) {
+        if (offset >= size)
+            break;
+        unsigned char byte(input[offset++]);
+        number |= uint64_t(byte & 0x7f) << shift;
+        if (! (byte & 0x80))
+            return number;
+    }
+    throw error(SQLITE_CORRUPT, "malformed compressed value header");
+}
+
+void destroy_codec(void *algorithm) {
+    delete static_cast<std::shared_ptr<const codec> *>(algorithm);
+}
+
+const codec& function_codec(sqlite3_context *context) {
+    return **static_cast<std::shared_ptr<const codec> *>(sqlite3_user_data(context));
+}
+
+void compress_function(sqlite3_context *context, int, sqlite3_value **argv) {
+    int type(sqlite3_value_type(argv[0]));
+    if (type != SQLITE_TEXT && type != SQLITE_BLOB) {
+        sqlite3_result_value(context, argv[0]);
+        return;
+    }
+    const void *data(
+        type == SQLITE_TEXT ? sqlite3_value_text(argv[0]) : sqlite3_value_blob(argv[0])
+    );
+    std::size_t size(sqlite3_value_bytes(argv[0]));
+    try {
+        std::string frame, compressed;
+        detail::encode_frame(
+            function_codec(context), static_cast<const char *>(data), size,
+            type == SQLITE_TEXT, 0, frame, compressed
+        );
+        sqlite3_result_blob64(context, frame.data(), frame.size(), SQLITE_TRANSIENT);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    } catch (const std::exception &failure) {
+        sqlite3_result_error(context, failure.what(), -1);
+    }
+}
+
+void decompress_function(sqlite3_context *context, int, sqlite3_value **argv) {
+    if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) {
+        sqlite3_result_value(context, argv[0]);
+        return;
+    }
+    const void *frame(sqlite3_value_blob(argv[0]));
+    std::size_t size(sqlite3_value_bytes(argv[0]));
+    try {
+        std::string output;
+        bool is_text(detail::decode_frame(
+            function_codec(context), static_cast<const char *>(frame), size, output
+        ));
+        if (is_text)
+            sqlite3_result_text64(context, output.data(), output.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+        else
+            sqlite3_result_blob64(context, output.data(), output.size(), SQLITE_TRANSIENT);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    } catch (const std::exception &failure) {
+        sqlite3_result_error(context, failure.what(), -1);
+    }
+}
+
+}
+
+std::shared_ptr<const codec> lz_codec() {
+    static const std::shared_ptr<const codec> instance(std::make_shared<lz>());
+    return instance;
+}
+
+column_codec::column_codec(
+        const std::shared_ptr<const codec> &algorithm,
+        const std::size_t &minimum_size
+): algorithm(algorithm), minimum_size(minimum_size) {
+    assert(algorithm && "column_codec requires a codec");
+}
+
+void column_codec::bind(
+        statement &stmt,
+        const std::size_t &index,
+        const std::string &text
+) {
+    sqlite3_stmt *raw(stmt.stmt.get());
+    assert(raw && "bind() called on null sqlite::statement");
+    (void) sqlite3_reset(raw);
+    detail::encode_frame(
+        *algorithm, text.data(), text.size(), true, minimum_size, frame,
+        compressed
+    );
+    // Copied by sqlite, a buffer per bound statement would outlive them
+    auto status(sqlite3_bind_blob64(
+        raw, index, frame.data(), frame.size(), SQLITE_TRANSIENT
+    ));
+    if (status != SQLITE_OK)
+        throw error(stmt.stmt, "while binding parameter " + std::to_string(index));
+    auto capture(detail::capturing_bindings(raw));
+    if (capture) {
+        detail::note_binding(
+            *capture, raw, index, value(value_type::blob, frame.data(), frame.size())
+        );
+    }
+}
+
+void column_codec::bind(
+        statement &stmt,
+        const std::string &parameter,
+        const std::string &text
+) {
+    sqlite3_stmt *raw(stmt.stmt.get());
+    assert(raw && "bind() called on null sqlite::statement");
+    auto index(sqlite3_bind_parameter_index(raw, parameter.c_str()));
+    if (! index)
+        throw error(stmt.stmt, "while binding parameter '" + parameter + "'");
+    bind(stmt, index, text);
+}
+
+const std::string& column_codec::read(const field &column) {
+    sqlite3_stmt *raw(column.stmt.get());
+    switch (sqlite3_column_type(raw, column.index)) {
+    case SQLITE_BLOB: {
+        auto frame(static_cast<const char *>(sqlite3_column_blob(raw, column.index)));
+        std::size_t size(sqlite3_column_bytes(raw, column.index));
+        (void) detail::decode_frame(*algorithm, frame, size, buffer);
+        break;
+    }
+    case SQLITE_NULL:
+        buffer.clear();
+        break;
+    default: {
+        // Values written before compression was enabled are read as text
+        auto text(reinterpret_cast<const char *>(sqlite3_column_text(raw, column.index)));
+        buffer.assign(text, sqlite3_column_bytes(raw, column.index));
+    }
+    }
+    return buffer;
+}
+
+const std::string& column_codec::read(const value &column) {
+    switch (column.type()) {
+    case value_type::blob:
+        (void) detail::decode_frame(*algorithm, column.data(), column.size(), buffer);
+        break;
+    case value_type::null:
+        buffer.clear();
+        break;
+    default:
+        buffer = column.as<std::string>();
+    }
+    return buffer;
+}
+
+namespace detail {
+
+// A frame is a marker byte recording whether the value was compressed and
+// whether it was text, the original length as a varint, then the payload
+void encode_frame(
+        const codec &algorithm,
+        const char *data,
+        const std::size_t &size,
+        const bool &is_text,
+        const std::size_t &minimum_size,
+        std::string &frame,
+        std::string &compressed
+) {
+    unsigned char marker(frame_marker | (is_text ? frame_text : 0));
+    frame.clear();
+    frame += static_cast<char>(marker | frame_compressed);
+    put_varint(frame, size);
+    std::size_t header(frame.size());
+    if (size >= minimum_size && size) {
+        algorithm.compress(data, size, compressed);
+        if (compressed.size() < size) {
+            frame += compressed;
+            return;
+        }
+    }
+    frame.resize(header);
+    frame[0] = static_cast<char>(marker);
+    frame.append(data, size);
+}
+
+bool decode_frame(
+        const codec &algorithm,
+        const char *frame,
+        const std::size_t &size,
+        std::string &output
+) {
+    auto input(reinterpret_cast<const unsigned char *>(frame));
+    if (! size || (input[0] & ~(frame_compressed | frame_text)) != frame_marker)
+        throw error(SQLITE_CORRUPT, "value is not a compressed frame");
+    std::size_t offset(1);
+    uint64_t original_size(get_varint(input, offset, size));
+    if (input[0] & frame_compressed) {
+        algorithm.decompress(frame + offset, size - offset, original_size, output);
+    } else {
+        if (original_size != size - offset)
+            throw error(SQLITE_CORRUPT, "stored value length mismatch");
+        output.assign(frame + offset, size - offset);
+    }
+    return input[0] & frame_text;
+}
+
+void register_codec_functions(
+        sqlite3 *db,
+        const std::shared_ptr<const codec> &algorithm
+) {
+    int flags(SQLITE_UTF8 | SQLITE_DETERMINISTIC);
+#ifdef SQLITE_INNOCUOUS
+    flags |= SQLITE_INNOCUOUS;
+#endif
+    const std::string prefix(algorithm->name());
+    const std::pair<std::string, void (*)(sqlite3_context *, int, sqlite3_value **)>
+    functions[] = {
+        {prefix + "_compress", &compress_function},
+        {prefix + "_decompress", &decompress_function}
+    };
+    for (const auto &function : functions) {
+        // Each registration owns a reference to the codec, released by sqlite
+        int status(sqlite3_create_function_v2(
+            db, function.first.c_str(), 1, flags,
+            new std::shared_ptr<const codec>(algorithm),
+            function.second, nullptr, nullptr, &destroy_codec
+        ));
+        if (status != SQLITE_OK)
+            throw error(status, "while registering " + function.first);
+    }
+}
+
+} // namespace detail
+
+} // namespace sqlite
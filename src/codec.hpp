@@ -0,0 +1,120 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_CODEC_H
+#define SQLITE_CODEC_H
+
+#include "statement.hpp"
+#include "field.hpp"
+#include "value.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqlite {
+
+// A compression algorithm. The name also names the SQL functions
+// <name>_compress(x) and <name>_decompress(x) registered for it.
+class codec {
+public:
+    virtual ~codec() = default;
+
+    virtual const char* name() const = 0;
+    virtual void compress(
+            const char *data,
+            const std::size_t &size,
+            std::string &output
+    ) const = 0;
+    // Throws error if the input is corrupt
+    virtual void decompress(
+            const char *data,
+            const std::size_t &size,
+            const std::size_t &original_size,
+            std::string &output
+    ) const = 0;
+};
+
+// The built-in byte oriented LZ77 compressor, named "lz"
+std::shared_ptr<const codec> lz_codec();
+
+// Compresses values as they are bound and decompresses them as they are
+// read, reusing its buffers. Values shorter than minimum_size, or that
+// don't shrink, are stored uncompressed in the same framing. sqlite copies
+// the compressed value when it is bound.
+class column_codec {
+public:
+    explicit column_codec(
+            const std::shared_ptr<const codec> &algorithm = lz_codec(),
+            const std::size_t &minimum_size = 64
+    );
+    column_codec(const column_codec &other) = delete;
+
+    column_codec& operator=(const column_codec &other) = delete;
+
+    void bind(statement &stmt, const std::size_t &index, const std::string &text);
+    void bind(
+            statement &stmt,
+            const std::string &parameter,
+            const std::string &text
+    );
+
+    // The returned reference is valid until the next call to read()
+    const std::string& read(const field &column);
+    const std::string& read(const value &column);
+
+private:
+    std::shared_ptr<const codec> algorithm;
+    const std::size_t minimum_size;
+    std::string frame;
+    std::string compressed;
+    std::string buffer;
+};
+
+namespace detail {
+
+void encode_frame(
+        const codec &algorithm,
+        const char *data,
+        const std::size_t &size,
+        const bool &is_text,
+        const std::size_t &minimum_size,
+        std::string &frame,
+        std::string &compressed
+);
+// Returns whether the framed value was text
+bool decode_frame(
+        const codec &algorithm,
+        const char *frame,
+        const std::size_t &size,
+        std::string &output
+);
+
+void register_codec_functions(
+        sqlite3 *db,
+        const std::shared_ptr<const codec> &algorithm
+);
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_CODEC_H
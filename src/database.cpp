@@ -16,9 +16,18 @@
 
 #include "database.hpp"
 #include "error.hpp"
+#include "affinity.hpp"
+#include "deadline.hpp"
+#include "workload.hpp"
+#include "similarity.hpp"
+#include "governor.hpp"
+#include "codec.hpp"
 
 #include <sqlite3.h>
 
+#include <atomic>
+#include <cctype>
+#include <cstring>
 #include <ostream>
 #include <sstream>
 #include <cassert>
@@ -34,6 +43,113 @@ void throw_on_error(const int status, sqlite3 *db) {
     }
 }
 
+int run_to_completion(sqlite3_stmt *stmt) {
+    int status;
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {}
+    return status;
+}
+
+void step_to_completion(const std::shared_ptr<sqlite3_stmt> &stmt) {
+    auto status(run_to_completion(stmt.get()));
+    if (status == SQLITE_DONE)
+        return;
+    if (status == SQLITE_BUSY || status == SQLITE_LOCKED) {
+        (void) sqlite3_reset(stmt.get());
+        throw transaction_failed(status);
+    }
+    if (status == SQLITE_INTERRUPT) {
+        (void) sqlite3_reset(stmt.get());
+        throw interrupted(status);
+    }
+    error failure(stmt);
+    (void) sqlite3_reset(stmt.get());
+    throw failure;
+}
+
+const std::string& pragma_value(const std::string &value) {
+    for (char c : value) {
+        if (! std::isalnum(static_cast<unsigned char>(c)))
+            throw error("invalid pragma value '" + value + "'");
+    }
+    return value;
+}
+
+std::string lower_case(std::string text) {
+    for (char &c : text)
+        c = std::tolower(static_cast<unsigned char>(c));
+    return text;
+}
+
+bool is_explain(const std::string &sql) {
+    std::size_t start(sql.find_first_not_of(" \t\r\n"));
+    return start != std::string::npos
+        && sqlite3_strnicmp(sql.c_str() + start, "EXPLAIN", 7) == 0;
+}
+
+}   // namespace
+
+namespace detail {
+
+std::size_t next_statement_slot() {
+    static std::atomic<std::size_t> next_slot(0);
+    return next_slot++;
+}
+
+std::string quote_identifier(const std::string &name) {
+    std::string quoted("\"");
+    for (char c : name) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+struct scan_guard {
+    scan_callback callback;
+    std::size_t step_threshold;
+};
+
+struct trace_hub {
+    std::shared_ptr<scan_guard> guard;
+    std::shared_ptr<workload_recorder> recorder;
+};
+
+} // namespace detail
+
+namespace {
+
+void check_full_scan_steps(detail::scan_guard &guard, sqlite3_stmt *stmt) {
+    std::size_t steps(
+        sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1)
+    );
+    if (steps < guard.step_threshold)
+        return;
+    plan_warning warning;
+    const char *sql(sqlite3_sql(stmt));
+    warning.sql = sql ? sql : "";
+    warning.full_scan_steps = steps;
+    try {
+        guard.callback(warning);
+    } catch (...) {
+        // Can't throw through sqlite
+    }
+}
+
+int dispatch_trace(unsigned type, void *context, void *statement, void *) {
+    auto hub(static_cast<detail::trace_hub *>(context));
+    auto stmt(static_cast<sqlite3_stmt *>(statement));
+    if (type == SQLITE_TRACE_STMT) {
+        hub->recorder->started(stmt);
+        return 0;
+    }
+    if (hub->recorder)
+        hub->recorder->record(stmt);
+    if (hub->guard)
+        check_full_scan_steps(*hub->guard, stmt);
+    return 0;
+}
+
 }   // namespace
 
 std::ostream& operator<<(std::ostream &os, const access_mode &mode) {
@@ -58,39 +174,272 @@ std::ostream& operator<<(std::ostream &os, const cache_type &cache) {
 database::database(
         const std::string &path,
         const access_mode &permissions,
-        const cache_type &visibility
+        const cache_type &visibility,
+        const threading_mode &threading
 ) {
-    int perms(permissions | visibility);
+    int perms(static_cast<int>(permissions) | visibility | threading);
     throw_on_error(sqlite3_open_v2(path.c_str(), &db, perms, nullptr), db);
+    if (threading == multi_thread)
+        detail::claim_connection(db);
+    cache_share = detail::register_connection(db);
 }
 
 database::database(
         const special_t &,
         const access_mode &permissions,
-        const cache_type &visibility
+        const cache_type &visibility,
+        const threading_mode &threading
 ) {
     std::stringstream uri;
     uri << "file::memory:?" << permissions << "&" << visibility;
     std::string path(uri.str());
     throw_on_error(
         sqlite3_open_v2(
-            path.c_str(), &db, permissions | SQLITE_OPEN_URI, nullptr
+            path.c_str(), &db,
+            static_cast<int>(permissions) | threading | SQLITE_OPEN_URI, nullptr
         ), db
     );
+    if (threading == multi_thread)
+        detail::claim_connection(db);
+    cache_share = detail::register_connection(db);
+}
+
+database::database(database &&other) noexcept:
+    db(other.db),
+    slots(std::move(other.slots)),
+    guard(std::move(other.guard)),
+    interrupts(std::move(other.interrupts)),
+    changes(std::move(other.changes)),
+    recorder(std::move(other.recorder)),
+    tracing(std::move(other.tracing)),
+    cache_share(std::move(other.cache_share)),
+    pinned_images(std::move(other.pinned_images)),
+    existence_filters(std::move(other.existence_filters)),
+    schema_generation(other.schema_generation) {
+    other.db = nullptr;
 }
 
 database::~database() {
     close();
 }
 
+database& database::operator=(database &&other) noexcept {
+    if (this != &other) {
+        close();
+        db = other.db;
+        other.db = nullptr;
+        slots = std::move(other.slots);
+        guard = std::move(other.guard);
+        interrupts = std::move(other.interrupts);
+        changes = std::move(other.changes);
+        recorder = std::move(other.recorder);
+        tracing = std::move(other.tracing);
+        cache_share = std::move(other.cache_share);
+        pinned_images = std::move(other.pinned_images);
+        existence_filters = std::move(other.existence_filters);
+        schema_generation = other.schema_generation;
+    }
+    return *this;
+}
+
 result database::execute(const std::string &sql) {
     return create_statement(sql);
 }
 
 result database::execute(const statement &statement) {
+    apply_cache_share();
     return make_result(statement);
 }
 
+exec_status database::exec(const statement &statement) {
+    assert(statement.stmt && "exec() called on null sqlite::statement");
+    detail::check_affinity(db);
+    apply_cache_share();
+    (void) sqlite3_reset(statement.stmt.get());
+    step_to_completion(statement.stmt);
+    (void) sqlite3_reset(statement.stmt.get());
+    return completed(statement);
+}
+
+expected<result> database::try_execute(const statement &statement) {
+    assert(statement.stmt && "try_execute() called on null sqlite::statement");
+    detail::check_affinity(db);
+    apply_cache_share();
+    (void) sqlite3_reset(statement.stmt.get());
+    auto status(sqlite3_step(statement.stmt.get()));
+    if (status != SQLITE_ROW && status != SQLITE_DONE)
+        return error_code(status, statement.stmt);
+    return result(statement.stmt, status == SQLITE_DONE);
+}
+
+expected<exec_status> database::try_exec(const statement &statement) {
+    assert(statement.stmt && "try_exec() called on null sqlite::statement");
+    detail::check_affinity(db);
+    apply_cache_share();
+    (void) sqlite3_reset(statement.stmt.get());
+    auto status(run_to_completion(statement.stmt.get()));
+    (void) sqlite3_reset(statement.stmt.get());
+    if (status != SQLITE_DONE)
+        return error_code(status, statement.stmt);
+    return completed(statement);
+}
+
+exec_status database::completed(const statement &statement) const {
+    exec_status status;
+    if (! sqlite3_stmt_readonly(statement.stmt.get()))
+        status.changes = sqlite3_changes(db);
+    status.last_insert_rowid = sqlite3_last_insert_rowid(db);
+    return status;
+}
+
+std::size_t database::execute_script(const std::string &sql) {
+    detail::check_affinity(db);
+    apply_cache_share();
+    const char *tail(sql.c_str());
+    const char *end(tail + sql.size());
+    std::size_t executed(0);
+    while (tail < end) {
+        sqlite3_stmt *stmt(nullptr);
+        auto status(sqlite3_prepare_v2(db, tail, end - tail, &stmt, &tail));
+        if (status != SQLITE_OK) {
+            throw error(status, "while preparing statement " +
+                std::to_string(executed + 1) + " of sql script");
+        }
+        if (! stmt)
+            continue;
+        step_to_completion(std::shared_ptr<sqlite3_stmt>(stmt, &detail::finalize_statement));
+        ++executed;
+    }
+    return executed;
+}
+
+attachment database::attach(
+        const std::string &path,
+        const std::string &schema,
+        const schema_options &options
+) {
+    statement attaching(create_statement("ATTACH DATABASE ? AS ?;"));
+    attaching.bind(1, path);
+    attaching.bind(2, schema);
+    (void) exec(attaching);
+    ++schema_generation;
+    attachment handle(*this, schema);
+    configure(schema, options);
+    return handle;
+}
+
+void database::detach(const std::string &schema) {
+    // Cached statements may still hold a read on the schema, which would
+    // stop it from being detached
+    for (const std::unique_ptr<statement> &slot : slots) {
+        if (slot)
+            (void) sqlite3_reset(slot->stmt.get());
+    }
+    statement detaching(create_statement("DETACH DATABASE ?;"));
+    detaching.bind(1, schema);
+    (void) exec(detaching);
+    pinned_images.erase(schema);
+    ++schema_generation;
+}
+
+void database::configure(
+        const std::string &schema,
+        const schema_options &options
+) {
+    std::string pragma("PRAGMA " + detail::quote_identifier(schema) + ".");
+    if (options.cache_size) {
+        (void) execute_script(
+            pragma + "cache_size = " + std::to_string(options.cache_size) + ";"
+        );
+    }
+    if (! options.journal_mode.empty()) {
+        auto mode(execute_scalar<std::string>(
+            pragma + "journal_mode = " + pragma_value(options.journal_mode) + ";"
+        ));
+        if (lower_case(mode) != lower_case(options.journal_mode)) {
+            throw error("unable to set the journal_mode of schema " + schema +
+                " to " + options.journal_mode + ", it remains " + mode);
+        }
+    }
+    if (! options.synchronous.empty()) {
+        (void) execute_script(
+            pragma + "synchronous = " + pragma_value(options.synchronous) + ";"
+        );
+    }
+}
+
+std::vector<std::string> database::schemas() const {
+    std::vector<std::string> names;
+    result rows(create_statement("PRAGMA database_list;"));
+    for (const row &row : rows)
+        names.push_back(row[1].as<std::string>());
+    return names;
+}
+
+memdb_image database::serialize(const std::string &schema) const {
+    detail::check_affinity(db);
+    sqlite3_int64 size(0);
+    unsigned char *bytes(sqlite3_serialize(db, schema.c_str(), &size, 0));
+    if (! bytes && size)
+        throw error(SQLITE_NOMEM, "while serializing schema " + schema);
+    return memdb_image(
+        std::shared_ptr<const unsigned char>(bytes, &sqlite3_free), size
+    );
+}
+
+void database::deserialize(
+        const memdb_image &image,
+        const access_mode &permissions,
+        const std::string &schema
+) {
+    detail::check_affinity(db);
+    unsigned char *bytes;
+    unsigned flags;
+    if (permissions == read_only) {
+        // Read only images are used in place, so keep them alive until close
+        bytes = const_cast<unsigned char *>(image.data());
+        flags = SQLITE_DESERIALIZE_READONLY;
+    } else {
+        bytes = static_cast<unsigned char *>(
+            sqlite3_malloc64(image.size() ? image.size() : 1)
+        );
+        if (! bytes)
+            throw error(SQLITE_NOMEM, "while deserializing schema " + schema);
+        if (image.size())
+            std::memcpy(bytes, image.data(), image.size());
+        flags = SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE;
+    }
+    auto status(sqlite3_deserialize(
+        db, schema.c_str(), bytes, image.size(), image.size(), flags
+    ));
+    if (status != SQLITE_OK)
+        throw error(status, "while deserializing schema " + schema);
+    if (permissions == read_only)
+        pinned_images[schema] = image;
+    else
+        pinned_images.erase(schema);
+}
+
+threading_mode database::threading() const {
+    return sqlite3_db_mutex(db) ? serialized : multi_thread;
+}
+
+void database::release_memory() {
+    assert(db && "release_memory() called on closed sqlite::database");
+    detail::check_affinity(db);
+    (void) sqlite3_db_release_memory(db);
+}
+
+void database::apply_cache_share() const {
+    if (cache_share)
+        detail::apply_cache_share(*cache_share);
+}
+
+void database::claim_thread() {
+    if (threading() == multi_thread)
+        detail::claim_connection(db);
+}
+
 std::size_t database::size() const {
     std::size_t page_count(execute_scalar<std::size_t>("PRAGMA page_count;"));
     std::size_t page_size(execute_scalar<std::size_t>("PRAGMA page_size;"));
@@ -98,6 +447,15 @@ std::size_t database::size() const {
 }
 
 void database::close() noexcept {
+    slots.clear();
+    existence_filters.clear();
+    detail::release_connection(db);
+    detail::unregister_connection(db);
+    cache_share.reset();
+    if (interrupts) {
+        std::lock_guard<std::mutex> lock(interrupts->mutex);
+        interrupts->db = nullptr;
+    }
     auto status(sqlite3_close(db));
     db = nullptr;
     // Can't throw, called from destructor
@@ -110,19 +468,175 @@ void database::close() noexcept {
 std::shared_ptr<sqlite3_stmt> database::create_statement(
         const std::string &sql
 ) const {
+    detail::check_affinity(db);
+    apply_cache_share();
     sqlite3_stmt *stmt(nullptr);
     auto status(sqlite3_prepare_v2(
         db, sql.c_str(), sql.size(), &stmt, nullptr
     ));
     if (status != SQLITE_OK)
         throw error(status, "while preparing sql statement '" + sql + "'");
-    return std::shared_ptr<sqlite3_stmt>(stmt, &sqlite3_finalize);
+    auto capture(stmt ? detail::capturing_bindings(stmt) : nullptr);
+    if (capture)
+        detail::note_prepared(*capture, stmt);
+    return std::shared_ptr<sqlite3_stmt>(stmt, &detail::finalize_statement);
+}
+
+statement& database::slot_statement(const std::size_t &slot, const char *sql) {
+    if (slot >= slots.size())
+        slots.resize(slot + 1);
+    if (! slots[slot]) {
+        slots[slot].reset(new statement(create_statement(sql)));
+        if (guard)
+            check_plan(sql);
+    }
+    return *slots[slot];
 }
 
 statement database::prepare_statement(
         const std::string &sql
 ) const {
-    return create_statement(sql);
+    statement prepared(create_statement(sql));
+    if (guard)
+        check_plan(sql);
+    return prepared;
+}
+
+std::shared_ptr<detail::interrupt_state> database::interruption() {
+    assert(db && "interruption() called on closed sqlite::database");
+    if (! interrupts) {
+        interrupts = std::make_shared<detail::interrupt_state>();
+        interrupts->db = db;
+    }
+    return interrupts;
+}
+
+query_plan database::explain(const std::string &sql) const {
+    result rows(create_statement("EXPLAIN QUERY PLAN " + sql));
+    std::vector<plan_step> steps;
+    for (const row &row : rows) {
+        plan_step step;
+        step.id = row[0].as<int>();
+        step.parent = row[1].as<int>();
+        step.detail = row[3].as<std::string>();
+        steps.push_back(step);
+    }
+    return steps;
+}
+
+void database::enable_scan_guard(
+        const scan_callback &callback,
+        const std::size_t &step_threshold
+) {
+    assert(callback && "scan guard enabled without a callback");
+    auto replacement(std::make_shared<detail::scan_guard>());
+    replacement->callback = callback;
+    replacement->step_threshold = step_threshold;
+    guard = replacement;
+    update_trace();
+}
+
+void database::disable_scan_guard() {
+    guard.reset();
+    update_trace();
+}
+
+void database::enable_vector_functions() {
+    assert(db && "enable_vector_functions() called on closed sqlite::database");
+    detail::check_affinity(db);
+    detail::register_vector_functions(db);
+}
+
+void database::register_codec(const std::shared_ptr<const codec> &algorithm) {
+    assert(db && "register_codec() called on closed sqlite::database");
+    assert(algorithm && "register_codec() called without a codec");
+    detail::check_affinity(db);
+    detail::register_codec_functions(db, algorithm);
+}
+
+void database::start_recording(const std::string &path) {
+    assert(db && "start_recording() called on closed sqlite::database");
+    recorder = std::make_shared<detail::workload_recorder>(db, path);
+    update_trace();
+}
+
+void database::stop_recording() {
+    auto finished(recorder);
+    recorder.reset();
+    update_trace();
+    if (finished)
+        finished->finish();
+}
+
+void database::update_trace() {
+    // One trace callback per connection, shared by everything that profiles
+    auto profile_scans(guard && guard->step_threshold);
+    if (! profile_scans && ! recorder) {
+        sqlite3_trace_v2(db, 0, nullptr, nullptr);
+        tracing.reset();
+        return;
+    }
+    auto hub(std::make_shared<detail::trace_hub>());
+    if (profile_scans)
+        hub->guard = guard;
+    hub->recorder = recorder;
+    unsigned events(SQLITE_TRACE_PROFILE | (recorder ? SQLITE_TRACE_STMT : 0));
+    sqlite3_trace_v2(db, events, &dispatch_trace, hub.get());
+    tracing = hub;
+}
+
+change_subscription database::subscribe_changes(const std::size_t &capacity) {
+    assert(db && "subscribe_changes() called on closed sqlite::database");
+    if (! changes) {
+        changes = std::make_shared<detail::change_hub>();
+        changes->attach(db);
+    }
+    auto queue(std::make_shared<detail::change_queue>(capacity));
+    changes->add(queue);
+    return change_subscription(queue);
+}
+
+void database::track_existence(
+        const std::string &table,
+        const std::string &column,
+        const existence_options &options
+) {
+    assert(db && "track_existence() called on closed sqlite::database");
+    existence_filters[table] = std::make_shared<detail::existence_filter>(
+        *this, table, column, options
+    );
+}
+
+void database::untrack_existence(const std::string &table) {
+    existence_filters.erase(table);
+}
+
+bool database::may_contain(const std::string &table, const value &key) {
+    auto found(existence_filters.find(table));
+    assert(
+        found != existence_filters.end() &&
+        "may_contain() called for a table without track_existence()"
+    );
+    if (found == existence_filters.end())
+        throw error("no existence filter for table " + table);
+    return found->second->may_contain(key);
+}
+
+void database::check_plan(const std::string &sql) const {
+    if (is_explain(sql))
+        return;
+    std::vector<std::string> scans;
+    try {
+        scans = explain(sql).full_scans();
+    } catch (const error &) {
+        return;
+    }
+    for (const std::string &detail : scans) {
+        plan_warning warning;
+        warning.sql = sql;
+        warning.detail = detail;
+        guard->callback(warning);
+    }
 }
 
 std::ostream& operator<<(std::ostream &os, const database &db) {
@@ -131,6 +645,32 @@ std::ostream& operator<<(std::ostream &os, const database &db) {
     return os;
 }
 
+attachment::attachment(database &db, const std::string &schema):
+    db(&db),
+    name(schema) {}
+
+attachment::attachment(attachment &&other) noexcept:
+    db(other.db),
+    name(std::move(other.name)) {
+    other.db = nullptr;
+}
+
+attachment::~attachment() {
+    try {
+        detach();
+    } catch (...) {
+        // Can't throw, called from destructor
+    }
+}
+
+void attachment::detach() {
+    if (! db)
+        return;
+    auto owner(db);
+    db = nullptr;
+    owner->detach(name);
+}
+
 void as_transaction(
         database &db,
         const std::function<void(database &)> &operations
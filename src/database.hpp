@@ -19,14 +19,37 @@
 
 #include "statement.hpp"
 #include "result.hpp"
+#include "expected.hpp"
+#include "plan.hpp"
+#include "change_feed.hpp"
+#include "memdb.hpp"
+#include "bloom.hpp"
 
+#include <map>
 #include <memory>
+#include <vector>
+#include <cstdint>
 #include <functional>
 
 struct sqlite3;
 
 namespace sqlite {
 
+namespace detail {
+
+struct static_statement_access;
+struct scan_guard;
+struct interrupt_state;
+struct trace_hub;
+struct cache_share;
+class workload_recorder;
+class existence_filter;
+
+std::size_t next_statement_slot();
+std::string quote_identifier(const std::string &name);
+
+} // namespace detail
+
 static char const *temporary = "";
 
 enum class special_t {
@@ -45,29 +68,55 @@ enum cache_type {
     private_cache = 0x00040000
 };
 
+enum threading_mode {
+    default_threading = 0x00000000,
+    multi_thread      = 0x00008000,
+    serialized        = 0x00010000
+};
+
+struct exec_status {
+    std::size_t changes = 0;
+    int64_t last_insert_rowid = 0;
+};
+
+struct schema_options {
+    int64_t cache_size = 0;
+    std::string journal_mode;
+    std::string synchronous;
+};
+
+class attachment;
+class codec;
+
 class database {
 public:
     database(
             const std::string &path,
             const access_mode &permissions,
-            const cache_type &visibility = private_cache
+            const cache_type &visibility = private_cache,
+            const threading_mode &threading = default_threading
     );
     database(
             const special_t &in_memory,
             const access_mode &permissions,
-            const cache_type &visibility = private_cache
+            const cache_type &visibility = private_cache,
+            const threading_mode &threading = default_threading
     );
     database(const database &other) = delete;
-    database(database &&other) = default;
+    database(database &&other) noexcept;
     ~database();
 
     database& operator=(const database &other) = delete;
-    database& operator=(database &&other) = default;
+    database& operator=(database &&other) noexcept;
 
     statement prepare_statement(const std::string &sql) const;
 
     result execute(const std::string &sql);
     result execute(const statement &statement);
+    exec_status exec(const statement &statement);
+    expected<result> try_execute(const statement &statement);
+    expected<exec_status> try_exec(const statement &statement);
+    std::size_t execute_script(const std::string &sql);
     template<typename T> T execute_scalar(const std::string &sql) const {
         result results(create_statement(sql));
         return (*results.begin())[0].as<T>();
@@ -77,16 +126,100 @@ public:
         return (*results.begin())[0].as<T>();
     }
 
+    query_plan explain(const std::string &sql) const;
+    void enable_scan_guard(
+            const scan_callback &callback,
+            const std::size_t &step_threshold = 0
+    );
+    void disable_scan_guard();
+
+    void enable_vector_functions();
+    void register_codec(const std::shared_ptr<const codec> &algorithm);
+
+    change_subscription subscribe_changes(const std::size_t &capacity = 4096);
+
+    void track_existence(
+            const std::string &table,
+            const std::string &column,
+            const existence_options &options = existence_options()
+    );
+    void untrack_existence(const std::string &table);
+    bool may_contain(const std::string &table, const value &key);
+
+    void start_recording(const std::string &path);
+    void stop_recording();
+
+    attachment attach(
+            const std::string &path,
+            const std::string &schema,
+            const schema_options &options = schema_options()
+    );
+    void detach(const std::string &schema);
+    void configure(const std::string &schema, const schema_options &options);
+    std::vector<std::string> schemas() const;
+
+    memdb_image serialize(const std::string &schema = "main") const;
+    void deserialize(
+            const memdb_image &image,
+            const access_mode &permissions = read_write,
+            const std::string &schema = "main"
+    );
+
     std::size_t size() const;
+    void release_memory();
+    threading_mode threading() const;
+    void claim_thread();
 
     friend std::ostream& operator<<(std::ostream &stream, const database &db);
 
 private:
+    friend struct detail::static_statement_access;
+    friend class checkpoint_manager;
+    friend class snapshot;
+    friend class snapshot_transaction;
+    friend class cancel_token;
+    friend class scoped_deadline;
+    friend class result_cache;
+    friend class detail::existence_filter;
+
     void close() noexcept;
+    exec_status completed(const statement &statement) const;
     std::shared_ptr<sqlite3_stmt> create_statement(const std::string &sql) const;
+    statement& slot_statement(const std::size_t &slot, const char *sql);
+    void check_plan(const std::string &sql) const;
+    std::shared_ptr<detail::interrupt_state> interruption();
+    void update_trace();
+    void apply_cache_share() const;
 
 private:
     sqlite3 *db = nullptr;
+    std::vector<std::unique_ptr<statement>> slots;
+    std::shared_ptr<detail::scan_guard> guard;
+    std::shared_ptr<detail::interrupt_state> interrupts;
+    std::shared_ptr<detail::change_hub> changes;
+    std::shared_ptr<detail::workload_recorder> recorder;
+    std::shared_ptr<detail::trace_hub> tracing;
+    std::shared_ptr<detail::cache_share> cache_share;
+    std::map<std::string, memdb_image> pinned_images;
+    std::map<std::string, std::shared_ptr<detail::existence_filter>> existence_filters;
+    std::size_t schema_generation = 0;
+};
+
+class attachment {
+public:
+    attachment(database &db, const std::string &schema);
+    attachment(const attachment &other) = delete;
+    attachment(attachment &&other) noexcept;
+    ~attachment();
+
+    attachment& operator=(const attachment &other) = delete;
+
+    const std::string& schema() const { return name; }
+    void detach();
+
+private:
+    database *db;
+    std::string name;
 };
 
 void as_transaction(
@@ -0,0 +1,108 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "deadline.hpp"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace sqlite {
+
+namespace {
+
+std::chrono::steady_clock::rep now() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+const int default_instruction_interval(1000);
+
+// sqlite3_interrupt only stops statements already running, so a cancel that
+// lands between statements is caught here instead
+int check_interrupt(void *context) {
+    auto state(static_cast<detail::interrupt_state *>(context));
+    if (state->cancelled.load(std::memory_order_acquire))
+        return 1;
+    auto deadline(state->deadline.load(std::memory_order_relaxed));
+    return deadline && now() >= deadline;
+}
+
+void install_handler(detail::interrupt_state &state) {
+    sqlite3_progress_handler(
+        state.db,
+        state.instruction_interval
+            ? state.instruction_interval : default_instruction_interval,
+        &check_interrupt,
+        &state
+    );
+}
+
+}   // namespace
+
+cancel_token::cancel_token(database &db): state(db.interruption()) {
+    install_handler(*state);
+}
+
+void cancel_token::cancel() noexcept {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->cancelled.store(true, std::memory_order_release);
+    if (state->db)
+        sqlite3_interrupt(state->db);
+}
+
+void cancel_token::reset() noexcept {
+    state->cancelled.store(false, std::memory_order_release);
+}
+
+bool cancel_token::cancelled() const noexcept {
+    return state->cancelled.load(std::memory_order_acquire);
+}
+
+scoped_deadline::scoped_deadline(
+        database &db,
+        const std::chrono::milliseconds &timeout,
+        const int &instruction_interval
+):
+    state(db.interruption()),
+    deadline(now() + std::chrono::duration_cast<
+        std::chrono::steady_clock::duration
+    >(timeout).count()),
+    previous_deadline(state->deadline.load(std::memory_order_relaxed)),
+    previous_interval(state->instruction_interval) {
+    assert(instruction_interval > 0 && "deadline checked every 0 instructions");
+    if (previous_deadline)
+        deadline = std::min(deadline, previous_deadline);
+    state->deadline.store(deadline, std::memory_order_relaxed);
+    state->instruction_interval = previous_interval
+        ? std::min(previous_interval, instruction_interval)
+        : instruction_interval;
+    install_handler(*state);
+}
+
+scoped_deadline::~scoped_deadline() {
+    state->deadline.store(previous_deadline, std::memory_order_relaxed);
+    state->instruction_interval = previous_interval;
+    if (state->db)
+        install_handler(*state);
+}
+
+bool scoped_deadline::expired() const {
+    return now() >= deadline;
+}
+
+} // namespace sqlite
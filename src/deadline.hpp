@@ -0,0 +1,81 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_DEADLINE_H
+#define SQLITE_DEADLINE_H
+
+#include "database.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+struct sqlite3;
+
+namespace sqlite {
+
+namespace detail {
+
+struct interrupt_state {
+    std::mutex mutex;
+    sqlite3 *db = nullptr;
+    std::atomic<bool> cancelled{false};
+    std::atomic<std::chrono::steady_clock::rep> deadline{0};
+    int instruction_interval = 0;
+};
+
+} // namespace detail
+
+// Once cancelled every statement on the connection is interrupted until
+// reset() is called
+class cancel_token {
+public:
+    explicit cancel_token(database &db);
+
+    void cancel() noexcept;
+    void reset() noexcept;
+    bool cancelled() const noexcept;
+
+private:
+    std::shared_ptr<detail::interrupt_state> state;
+};
+
+class scoped_deadline {
+public:
+    scoped_deadline(
+            database &db,
+            const std::chrono::milliseconds &timeout,
+            const int &instruction_interval = 1000
+    );
+    scoped_deadline(const scoped_deadline &other) = delete;
+    ~scoped_deadline();
+
+    scoped_deadline& operator=(const scoped_deadline &other) = delete;
+
+    bool expired() const;
+
+private:
+    std::shared_ptr<detail::interrupt_state> state;
+    std::chrono::steady_clock::rep deadline;
+    std::chrono::steady_clock::rep previous_deadline;
+    int previous_interval;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_DEADLINE_H
@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "expected.hpp"
+#include "result.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cstring>
+
+namespace sqlite {
+
+error_code::error_code(
+        const int status,
+        const std::shared_ptr<sqlite3_stmt> &stmt,
+        const std::size_t &parameter
+): status(status), stmt(stmt), parameter(parameter) {
+    // Busy and interrupted results are retried in loops and sqlite has
+    // nothing to add to them, keep those free of locks and allocations
+    if (! status || ! stmt || is_busy() || is_interrupted())
+        return;
+    // Later calls on the connection overwrite its message, and it only
+    // describes this failure if the connection reported the same error
+    sqlite3 *db(sqlite3_db_handle(stmt.get()));
+    if ((sqlite3_errcode(db) & 0xff) != (status & 0xff))
+        return;
+    const char *message(sqlite3_errmsg(db));
+    if (std::strcmp(message, sqlite3_errstr(status)) != 0)
+        detail = message;
+}
+
+bool error_code::is_busy() const noexcept {
+    return status == SQLITE_BUSY || status == SQLITE_LOCKED;
+}
+
+bool error_code::is_interrupted() const noexcept {
+    return status == SQLITE_INTERRUPT;
+}
+
+std::string error_code::message() const {
+    return std::string(sqlite3_errstr(status)) + " " + context();
+}
+
+void error_code::raise() const {
+    if (is_busy())
+        throw transaction_failed(status, context());
+    if (is_interrupted())
+        throw interrupted(status, context());
+    throw error(status, context());
+}
+
+std::string error_code::context() const {
+    std::string text;
+    if (! detail.empty())
+        text = detail + " ";
+    if (parameter)
+        text += "while binding parameter " + std::to_string(parameter) + " of";
+    else
+        text += "while executing";
+    const char *sql(stmt ? sqlite3_sql(stmt.get()) : nullptr);
+    return text + " sql statement '" + (sql ? sql : "") + "'";
+}
+
+} // namespace sqlite
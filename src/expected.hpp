@@ -0,0 +1,141 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_EXPECTED_H
+#define SQLITE_EXPECTED_H
+
+#include <new>
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+struct sqlite3_stmt;
+
+namespace sqlite {
+
+class error_code {
+public:
+    error_code() = default;
+    explicit error_code(
+            const int status,
+            const std::shared_ptr<sqlite3_stmt> &stmt = nullptr,
+            const std::size_t &parameter = 0
+    );
+
+    int code() const noexcept { return status; }
+    bool is_busy() const noexcept;
+    bool is_interrupted() const noexcept;
+    explicit operator bool() const noexcept { return status != 0; }
+
+    std::string message() const;
+    [[noreturn]] void raise() const;
+
+private:
+    std::string context() const;
+
+private:
+    int status = 0;
+    std::shared_ptr<sqlite3_stmt> stmt;
+    std::size_t parameter = 0;
+    // sqlite3_errmsg at the time of failure, e.g. "no such table: x"
+    std::string detail;
+};
+
+template<typename T>
+class expected {
+public:
+    expected(T &&value): failure() { new (&stored) T(std::move(value)); }
+    expected(const T &value): failure() { new (&stored) T(value); }
+    expected(const error_code &failure): failure(failure) {}
+    expected(const expected &other): failure(other.failure) {
+        if (! failure)
+            new (&stored) T(other.stored);
+    }
+    expected(expected &&other): failure(std::move(other.failure)) {
+        if (! failure)
+            new (&stored) T(std::move(other.stored));
+    }
+    ~expected() {
+        if (! failure)
+            stored.~T();
+    }
+
+    expected& operator=(const expected &other) {
+        if (this != &other) {
+            this->~expected();
+            new (this) expected(other);
+        }
+        return *this;
+    }
+    expected& operator=(expected &&other) {
+        if (this != &other) {
+            this->~expected();
+            new (this) expected(std::move(other));
+        }
+        return *this;
+    }
+
+    bool has_value() const noexcept { return ! failure; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    T& value() {
+        if (failure)
+            failure.raise();
+        return stored;
+    }
+    const T& value() const {
+        if (failure)
+            failure.raise();
+        return stored;
+    }
+    T& operator*() { return stored; }
+    const T& operator*() const { return stored; }
+    T* operator->() { return &stored; }
+    const T* operator->() const { return &stored; }
+
+    const error_code& error() const noexcept { return failure; }
+
+private:
+    union {
+        T stored;
+    };
+    error_code failure;
+};
+
+template<>
+class expected<void> {
+public:
+    expected() = default;
+    expected(const error_code &failure): failure(failure) {}
+
+    bool has_value() const noexcept { return ! failure; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    void value() const {
+        if (failure)
+            failure.raise();
+    }
+
+    const error_code& error() const noexcept { return failure; }
+
+private:
+    error_code failure;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_EXPECTED_H
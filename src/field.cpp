@@ -24,21 +24,6 @@ namespace sqlite {
 
 class blob {};
 
-field::field(
-        const std::shared_ptr<sqlite3_stmt> &statement,
-        const std::size_t &parameter_index
-): stmt(statement), index(parameter_index) {
-    assert(statement && "received null sqlite3_stmt");
-}
-
-bool field::is_null() const {
-    return sqlite3_column_type(stmt.get(), index) == SQLITE_NULL;
-}
-
-field::operator bool() const {
-    return ! is_null();
-}
-
 std::string field::column_name() const {
     const char *name(sqlite3_column_name(stmt.get(), index));
     return name ? name : "";
@@ -50,53 +35,4 @@ blob field::as<blob>() const {
     return blob();
 }
 
-template<>
-double field::as<double>() const {
-    if (is_null())
-        return 0.0;
-    return sqlite3_column_double(stmt.get(), index);
-}
-
-template<>
-int field::as<int>() const {
-    if (is_null())
-        return 0;
-    return sqlite3_column_int(stmt.get(), index);
-}
-
-template<>
-bool field::as<bool>() const {
-    if (is_null())
-        return false;
-    return static_cast<bool>(sqlite3_column_int(stmt.get(), index));
-}
-
-template<>
-int64_t field::as<int64_t>() const {
-    if (is_null())
-        return 0;
-    return sqlite3_column_int64(stmt.get(), index);
-}
-
-template<>
-std::size_t field::as<std::size_t>() const {
-    if (is_null())
-        return 0;
-    return sqlite3_column_int64(stmt.get(), index);
-}
-
-template<>
-char field::as<char>() const {
-    if (is_null())
-        return '\0';
-    return *reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), index));
-}
-
-template<>
-std::string field::as<std::string>() const {
-    if (is_null())
-        return "";
-    return reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), index));
-}
-
 }   // namespace sqlite
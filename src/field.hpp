@@ -17,11 +17,13 @@
 #ifndef SQLITE_FIELD_H
 #define SQLITE_FIELD_H
 
+#include <sqlite3.h>
+
 #include <memory>
 #include <string>
+#include <cassert>
 #include <cstddef>
-
-struct sqlite3_stmt;
+#include <cstdint>
 
 namespace sqlite {
 
@@ -30,20 +32,77 @@ public:
     field(
             const std::shared_ptr<sqlite3_stmt> &statement,
             const std::size_t &parameter_index
-    );
+    ): stmt(statement), index(parameter_index) {
+        assert(statement && "received null sqlite3_stmt");
+    }
 
-    bool is_null() const;
-    explicit operator bool() const;
+    bool is_null() const {
+        return sqlite3_column_type(stmt.get(), index) == SQLITE_NULL;
+    }
+    explicit operator bool() const { return ! is_null(); }
 
     std::string column_name() const;
     template<typename T>
     T as() const;
 
 private:
+    friend class column_codec;
+
     std::shared_ptr<sqlite3_stmt> stmt;
     const std::size_t index;
 };
 
+// The accessors live in the header so that reading a column inlines into
+// the caller's decode loop
+template<>
+inline double field::as<double>() const {
+    if (is_null())
+        return 0.0;
+    return sqlite3_column_double(stmt.get(), index);
+}
+
+template<>
+inline int field::as<int>() const {
+    if (is_null())
+        return 0;
+    return sqlite3_column_int(stmt.get(), index);
+}
+
+template<>
+inline bool field::as<bool>() const {
+    if (is_null())
+        return false;
+    return static_cast<bool>(sqlite3_column_int(stmt.get(), index));
+}
+
+template<>
+inline int64_t field::as<int64_t>() const {
+    if (is_null())
+        return 0;
+    return sqlite3_column_int64(stmt.get(), index);
+}
+
+template<>
+inline std::size_t field::as<std::size_t>() const {
+    if (is_null())
+        return 0;
+    return sqlite3_column_int64(stmt.get(), index);
+}
+
+template<>
+inline char field::as<char>() const {
+    if (is_null())
+        return '\0';
+    return *reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), index));
+}
+
+template<>
+inline std::string field::as<std::string>() const {
+    if (is_null())
+        return "";
+    return reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), index));
+}
+
 }   // namespace sqlite
 
 #endif // SQLITE_FIELD_H
@@ -0,0 +1,238 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "governor.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <climits>
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+struct connection_registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<detail::cache_share>> connections;
+    int64_t page_cache_budget = 0;
+};
+
+// Never destroyed, databases with static storage may close after it would be
+connection_registry& registry() {
+    static connection_registry *instance(new connection_registry());
+    return *instance;
+}
+
+// Only connections with their own mutex may be used from whichever thread
+// happens to be governing memory
+bool is_serialized(sqlite3 *db) {
+    return sqlite3_db_mutex(db) != nullptr;
+}
+
+// Connections belong to other threads, so each is only handed its share and
+// sets it before running its next statement
+void rebalance(const connection_registry &connections) {
+    if (! connections.page_cache_budget || connections.connections.empty())
+        return;
+    int64_t share(connections.page_cache_budget / connections.connections.size());
+    for (const auto &connection : connections.connections)
+        connection->pending_kib.store(std::max<int64_t>(share / 1024, 1));
+}
+
+// Heap limits are only enforced, and usage only counted, while sqlite keeps
+// memory statistics. Builds with SQLITE_DEFAULT_MEMSTATUS=0 can turn them
+// back on, but only before sqlite initializes when the first database opens.
+void require_memory_statistics() {
+    static std::atomic<bool> enabled(false);
+    if (enabled.load() || ! sqlite3_compileoption_used("DEFAULT_MEMSTATUS=0"))
+        return;
+    if (sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 1) != SQLITE_OK)
+        throw error(
+            "sqlite was built with SQLITE_DEFAULT_MEMSTATUS=0, memory "
+            "governance must start before the first database is opened"
+        );
+    enabled.store(true);
+}
+
+int64_t cache_used(sqlite3 *db) {
+    int current(0), high_water(0);
+    (void) sqlite3_db_status(
+        db, SQLITE_DBSTATUS_CACHE_USED, &current, &high_water, 0
+    );
+    return current;
+}
+
+int64_t total_cache_used(const connection_registry &connections) {
+    int64_t total(0);
+    for (const auto &connection : connections.connections) {
+        if (is_serialized(connection->db))
+            total += cache_used(connection->db);
+    }
+    return total;
+}
+
+}
+
+int64_t set_soft_heap_limit(const int64_t &bytes) {
+    require_memory_statistics();
+    return sqlite3_soft_heap_limit64(bytes);
+}
+
+int64_t set_hard_heap_limit(const int64_t &bytes) {
+    require_memory_statistics();
+    return sqlite3_hard_heap_limit64(bytes);
+}
+
+int64_t set_page_cache_budget(const int64_t &bytes) {
+    auto &connections(registry());
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    int64_t previous(connections.page_cache_budget);
+    connections.page_cache_budget = std::max<int64_t>(bytes, 0);
+    rebalance(connections);
+    return previous;
+}
+
+int64_t release_memory() {
+    auto &connections(registry());
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    int64_t before(total_cache_used(connections));
+    for (const auto &connection : connections.connections) {
+        if (is_serialized(connection->db))
+            (void) sqlite3_db_release_memory(connection->db);
+    }
+    int64_t released(before - total_cache_used(connections));
+    // Only frees anything when sqlite shares one page cache between
+    // connections, as with SQLITE_ENABLE_MEMORY_MANAGEMENT
+    released += sqlite3_release_memory(INT_MAX);
+    return std::max<int64_t>(released, 0);
+}
+
+memory_statistics memory_usage(const bool &reset_high_water) {
+    require_memory_statistics();
+    memory_statistics usage;
+    usage.used = sqlite3_memory_used();
+    usage.high_water = sqlite3_memory_highwater(reset_high_water);
+    usage.soft_limit = sqlite3_soft_heap_limit64(-1);
+    usage.hard_limit = sqlite3_hard_heap_limit64(-1);
+    auto &connections(registry());
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    usage.page_cache_used = total_cache_used(connections);
+    usage.page_cache_budget = connections.page_cache_budget;
+    usage.connections = connections.connections.size();
+    usage.unmanaged_connections = std::count_if(
+        connections.connections.begin(),
+        connections.connections.end(),
+        [](const std::shared_ptr<detail::cache_share> &connection) {
+            return ! is_serialized(connection->db);
+        }
+    );
+    return usage;
+}
+
+memory_pressure_monitor::memory_pressure_monitor(
+        const int64_t &threshold,
+        const pressure_callback &callback,
+        const std::chrono::milliseconds &interval
+):
+    threshold(threshold),
+    callback(callback),
+    interval(interval) {
+    require_memory_statistics();
+    worker = std::thread(&memory_pressure_monitor::run, this);
+}
+
+memory_pressure_monitor::~memory_pressure_monitor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+std::size_t memory_pressure_monitor::releases() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return release_count;
+}
+
+void memory_pressure_monitor::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (! wake.wait_for(lock, interval, [this] { return stopping; })) {
+        if (sqlite3_memory_used() <= threshold)
+            continue;
+        lock.unlock();
+        auto usage(memory_usage());
+        (void) release_memory();
+        if (callback)
+            callback(usage);
+        lock.lock();
+        ++release_count;
+    }
+}
+
+namespace detail {
+
+std::shared_ptr<cache_share> register_connection(sqlite3 *db) {
+    auto share(std::make_shared<cache_share>());
+    share->db = db;
+    auto &connections(registry());
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    connections.connections.push_back(share);
+    rebalance(connections);
+    return share;
+}
+
+void unregister_connection(sqlite3 *db) {
+    if (! db)
+        return;
+    auto &connections(registry());
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    auto found(std::find_if(
+        connections.connections.begin(), connections.connections.end(),
+        [db](const std::shared_ptr<cache_share> &connection) {
+            return connection->db == db;
+        }
+    ));
+    if (found == connections.connections.end())
+        return;
+    connections.connections.erase(found);
+    rebalance(connections);
+}
+
+void apply_cache_share(cache_share &share) {
+    int64_t kib(share.pending_kib.exchange(0));
+    if (! kib)
+        return;
+    // A negative cache_size is in KiB rather than pages
+    std::string sql("PRAGMA main.cache_size = -" + std::to_string(kib) + ";");
+    auto status(sqlite3_exec(share.db, sql.c_str(), nullptr, nullptr, nullptr));
+    if (status != SQLITE_OK) {
+        // Retried before the next statement unless a newer share arrives
+        int64_t none(0);
+        (void) share.pending_kib.compare_exchange_strong(none, kib);
+        throw error(status, "while applying the page cache budget");
+    }
+}
+
+} // namespace detail
+
+} // namespace sqlite
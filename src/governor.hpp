@@ -0,0 +1,116 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_GOVERNOR_H
+#define SQLITE_GOVERNOR_H
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+struct sqlite3;
+
+namespace sqlite {
+
+struct memory_statistics {
+    int64_t used = 0;
+    int64_t high_water = 0;
+    int64_t page_cache_used = 0;
+    int64_t soft_limit = 0;
+    int64_t hard_limit = 0;
+    int64_t page_cache_budget = 0;
+    std::size_t connections = 0;
+    std::size_t unmanaged_connections = 0;
+};
+
+// Process-wide limits covering every sqlite connection, each returns the
+// previous value and a value of zero removes the limit. The limits, usage
+// figures and pressure monitor need sqlite's memory statistics. An sqlite
+// built with SQLITE_DEFAULT_MEMSTATUS=0 only turns them on when these are
+// first used before any database is opened, later calls throw error.
+int64_t set_soft_heap_limit(const int64_t &bytes);
+int64_t set_hard_heap_limit(const int64_t &bytes);
+
+// Splits the budget evenly between the page caches of all open databases,
+// rebalancing as they are opened and closed. Each database sets its new share
+// on its own thread, before it runs its next statement.
+int64_t set_page_cache_budget(const int64_t &bytes);
+
+// Frees cache memory held by every serialized connection, returns the
+// number of bytes released
+int64_t release_memory();
+
+memory_statistics memory_usage(const bool &reset_high_water = false);
+
+typedef std::function<void(const memory_statistics &)> pressure_callback;
+
+// Polls sqlite's heap usage and releases memory whenever it exceeds the
+// threshold, reporting the figures from before the release
+class memory_pressure_monitor {
+public:
+    memory_pressure_monitor(
+            const int64_t &threshold,
+            const pressure_callback &callback = pressure_callback(),
+            const std::chrono::milliseconds &interval =
+                std::chrono::milliseconds(100)
+    );
+    memory_pressure_monitor(const memory_pressure_monitor &other) = delete;
+    ~memory_pressure_monitor();
+
+    memory_pressure_monitor& operator=(
+            const memory_pressure_monitor &other
+    ) = delete;
+
+    std::size_t releases() const;
+
+private:
+    void run();
+
+private:
+    const int64_t threshold;
+    const pressure_callback callback;
+    const std::chrono::milliseconds interval;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::size_t release_count = 0;
+    std::thread worker;
+};
+
+namespace detail {
+
+// The page cache size a connection should switch to, zero when unchanged
+struct cache_share {
+    sqlite3 *db = nullptr;
+    std::atomic<int64_t> pending_kib{0};
+};
+
+std::shared_ptr<cache_share> register_connection(sqlite3 *db);
+void unregister_connection(sqlite3 *db);
+void apply_cache_share(cache_share &share);
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_GOVERNOR_H
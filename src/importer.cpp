@@ -0,0 +1,439 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "importer.hpp"
+#include "database.hpp"
+#include "statement.hpp"
+#include "error.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+namespace sqlite {
+
+namespace {
+
+class mapped_file {
+public:
+    mapped_file(const std::string &path);
+    mapped_file(const mapped_file &other) = delete;
+    ~mapped_file();
+
+    mapped_file& operator=(const mapped_file &other) = delete;
+
+    char* begin() const { return data; }
+    char* end() const { return data + size; }
+
+private:
+    char *data = nullptr;
+    std::size_t size = 0;
+};
+
+mapped_file::mapped_file(const std::string &path) {
+    int fd(::open(path.c_str(), O_RDONLY));
+    if (fd < 0)
+        throw error("unable to open '" + path + "' for import");
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw error("unable to determine the size of '" + path + "'");
+    }
+    size = info.st_size;
+    if (size) {
+        // Private and writable so quoted fields can be unescaped in place,
+        // modified pages are copied on write and never reach the file.
+        void *mapping(::mmap(
+            nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0
+        ));
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw error("unable to map '" + path + "' into memory");
+        }
+        data = static_cast<char *>(mapping);
+        (void) ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+    if (data)
+        ::munmap(data, size);
+}
+
+struct csv_field {
+    const char *data;
+    std::size_t size;
+    bool quoted;
+};
+
+struct csv_record {
+    std::size_t line;
+    std::size_t first_field;
+    std::size_t field_count;
+    bool malformed;
+};
+
+struct csv_batch {
+    std::vector<csv_record> records;
+    std::vector<csv_field> fields;
+};
+
+class csv_parser {
+public:
+    csv_parser(char *begin, char *end, const char delimiter):
+        position(begin), end(end), delimiter(delimiter) {}
+
+    bool at_end() const { return position == end; }
+    void parse(csv_batch &batch, const std::size_t &max_records);
+
+private:
+    void parse_record(csv_batch &batch);
+    csv_field parse_quoted_field(csv_record &record);
+    csv_field parse_plain_field();
+    void skip_to_field_end();
+
+private:
+    char *position;
+    char *end;
+    const char delimiter;
+    std::size_t line = 1;
+};
+
+void csv_parser::parse(csv_batch &batch, const std::size_t &max_records) {
+    batch.records.clear();
+    batch.fields.clear();
+    while (! at_end() && batch.records.size() < max_records)
+        parse_record(batch);
+}
+
+void csv_parser::parse_record(csv_batch &batch) {
+    csv_record record = {line, batch.fields.size(), 0, false};
+    for (;;) {
+        if (position != end && *position == '"')
+            batch.fields.push_back(parse_quoted_field(record));
+        else
+            batch.fields.push_back(parse_plain_field());
+        ++record.field_count;
+        if (position == end || *position != delimiter)
+            break;
+        ++position;
+    }
+    if (position != end) {
+        ++position;
+        ++line;
+    }
+    const csv_field &only(batch.fields.back());
+    if (record.field_count == 1 && ! only.quoted && only.size == 0) {
+        batch.fields.pop_back();
+        return;
+    }
+    batch.records.push_back(record);
+}
+
+csv_field csv_parser::parse_quoted_field(csv_record &record) {
+    char *start(++position);
+    char *out(start);
+    bool closed(false);
+    while (position != end) {
+        if (*position == '"') {
+            if (position + 1 == end || position[1] != '"') {
+                ++position;
+                closed = true;
+                break;
+            }
+            ++position;
+        } else if (*position == '\n') {
+            ++line;
+        }
+        if (out != position)
+            *out = *position;
+        ++out;
+        ++position;
+    }
+    if (position != end && *position == '\r')
+        ++position;
+    if (! closed || (
+            position != end && *position != delimiter && *position != '\n'
+    )) {
+        record.malformed = true;
+        skip_to_field_end();
+    }
+    return {start, static_cast<std::size_t>(out - start), true};
+}
+
+csv_field csv_parser::parse_plain_field() {
+    char *start(position);
+    skip_to_field_end();
+    std::size_t size(position - start);
+    if (size && start[size - 1] == '\r' && (position == end || *position == '\n'))
+        --size;
+    return {start, size, false};
+}
+
+void csv_parser::skip_to_field_end() {
+    while (position != end && *position != delimiter && *position != '\n')
+        ++position;
+}
+
+class batch_queue {
+public:
+    batch_queue(const std::size_t &capacity): capacity(capacity) {}
+
+    bool push(csv_batch &&batch);
+    bool pop(csv_batch &batch);
+    void close();
+    void cancel();
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<csv_batch> batches;
+    const std::size_t capacity;
+    bool closed = false;
+    bool cancelled = false;
+};
+
+bool batch_queue::push(csv_batch &&batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] {
+        return cancelled || batches.size() < capacity;
+    });
+    if (cancelled)
+        return false;
+    batches.push_back(std::move(batch));
+    changed.notify_all();
+    return true;
+}
+
+bool batch_queue::pop(csv_batch &batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return closed || ! batches.empty(); });
+    if (batches.empty())
+        return false;
+    batch = std::move(batches.front());
+    batches.pop_front();
+    changed.notify_all();
+    return true;
+}
+
+void batch_queue::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    changed.notify_all();
+}
+
+void batch_queue::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+    changed.notify_all();
+}
+
+bool parse_integer(const csv_field &field, int64_t &value) {
+    const char *c(field.data);
+    const char *end(field.data + field.size);
+    bool negative(false);
+    if (c != end && (*c == '-' || *c == '+'))
+        negative = (*c++ == '-');
+    if (c == end)
+        return false;
+    const std::uint64_t limit(
+        negative ? std::uint64_t(INT64_MAX) + 1 : std::uint64_t(INT64_MAX)
+    );
+    std::uint64_t magnitude(0);
+    for (; c != end; ++c) {
+        if (*c < '0' || *c > '9')
+            return false;
+        unsigned digit(*c - '0');
+        if (magnitude > (limit - digit) / 10)
+            return false;
+        magnitude = magnitude * 10 + digit;
+    }
+    value = negative ? -int64_t(magnitude - 1) - 1 : int64_t(magnitude);
+    return true;
+}
+
+bool parse_real(const csv_field &field, double &value) {
+    char text[64];
+    if (field.size == 0 || field.size >= sizeof(text))
+        return false;
+    std::memcpy(text, field.data, field.size);
+    text[field.size] = '\0';
+    char *parsed_end(nullptr);
+    value = std::strtod(text, &parsed_end);
+    return parsed_end == text + field.size;
+}
+
+bool bind_record(
+        statement &insert,
+        const csv_batch &batch,
+        const csv_record &record,
+        const std::vector<csv_column> &columns
+) {
+    for (std::size_t i(0); i < record.field_count; ++i) {
+        const csv_field &field(batch.fields[record.first_field + i]);
+        csv_column type(i < columns.size() ? columns[i] : csv_column::text);
+        std::size_t index(i + 1);
+        if (type != csv_column::text && field.size == 0 && ! field.quoted) {
+            insert.bind(index, null);
+            continue;
+        }
+        switch (type) {
+        case csv_column::text:
+            insert.bind(index, field.data, field.size);
+            break;
+        case csv_column::integer: {
+            int64_t value;
+            if (! parse_integer(field, value))
+                return false;
+            insert.bind(index, value);
+            break;
+        }
+        case csv_column::real: {
+            double value;
+            if (! parse_real(field, value))
+                return false;
+            insert.bind(index, value);
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+bool insert_record(
+        database &db,
+        statement &insert,
+        const std::size_t &parameter_count,
+        const csv_batch &batch,
+        const csv_record &record,
+        const std::vector<csv_column> &columns
+) {
+    if (record.malformed || record.field_count != parameter_count)
+        return false;
+    if (! bind_record(insert, batch, record, columns))
+        return false;
+    try {
+        (void) db.exec(insert);
+    } catch (const transaction_failed &) {
+        throw;
+    } catch (const interrupted &) {
+        throw;
+    } catch (const error &) {
+        return false;
+    }
+    return true;
+}
+
+}   // namespace
+
+double import_report::rows_per_second() const {
+    return seconds > 0.0 ? rows_imported / seconds : 0.0;
+}
+
+import_report import_csv(
+        database &db,
+        const std::string &path,
+        statement &insert,
+        const csv_options &options
+) {
+    auto started(std::chrono::steady_clock::now());
+    mapped_file file(path);
+    csv_parser parser(file.begin(), file.end(), options.delimiter);
+    std::size_t rows_per_batch(std::max<std::size_t>(
+        options.rows_per_transaction, 1
+    ));
+    if (options.has_header) {
+        csv_batch header;
+        parser.parse(header, 1);
+    }
+
+    import_report report;
+    std::size_t parameter_count(insert.parameter_count());
+    auto insert_batch([&](const csv_batch &batch) {
+        if (batch.records.empty())
+            return;
+        as_transaction(db, [&](database &db) {
+            for (const csv_record &record : batch.records) {
+                if (insert_record(
+                        db, insert, parameter_count, batch, record,
+                        options.columns
+                )) {
+                    ++report.rows_imported;
+                } else {
+                    ++report.rows_rejected;
+                    report.rejected_lines.push_back(record.line);
+                }
+            }
+        });
+    });
+
+    if (options.parse_in_background) {
+        batch_queue queue(2);
+        std::exception_ptr parse_failure;
+        std::thread parser_thread([&] {
+            try {
+                while (! parser.at_end()) {
+                    csv_batch batch;
+                    parser.parse(batch, rows_per_batch);
+                    if (! queue.push(std::move(batch)))
+                        break;
+                }
+            } catch (...) {
+                parse_failure = std::current_exception();
+            }
+            queue.close();
+        });
+        try {
+            csv_batch batch;
+            while (queue.pop(batch))
+                insert_batch(batch);
+        } catch (...) {
+            queue.cancel();
+            parser_thread.join();
+            throw;
+        }
+        parser_thread.join();
+        if (parse_failure)
+            std::rethrow_exception(parse_failure);
+    } else {
+        csv_batch batch;
+        while (! parser.at_end()) {
+            parser.parse(batch, rows_per_batch);
+            insert_batch(batch);
+        }
+    }
+
+    std::chrono::duration<double> elapsed(
+        std::chrono::steady_clock::now() - started
+    );
+    report.seconds = elapsed.count();
+    return report;
+}
+
+} // namespace sqlite
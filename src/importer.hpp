@@ -0,0 +1,61 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_IMPORTER_H
+#define SQLITE_IMPORTER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace sqlite {
+
+class database;
+class statement;
+
+enum class csv_column {
+    text,
+    integer,
+    real
+};
+
+struct csv_options {
+    char delimiter = ',';
+    bool has_header = true;
+    std::vector<csv_column> columns;
+    std::size_t rows_per_transaction = 10000;
+    bool parse_in_background = false;
+};
+
+struct import_report {
+    std::size_t rows_imported = 0;
+    std::size_t rows_rejected = 0;
+    std::vector<std::size_t> rejected_lines;
+    double seconds = 0.0;
+
+    double rows_per_second() const;
+};
+
+import_report import_csv(
+        database &db,
+        const std::string &path,
+        statement &insert,
+        const csv_options &options = csv_options()
+);
+
+} // namespace sqlite
+
+#endif // SQLITE_IMPORTER_H
@@ -0,0 +1,129 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_MAPPING_H
+#define SQLITE_MAPPING_H
+
+#include "statement.hpp"
+#include "row.hpp"
+#include "field.hpp"
+
+#include <vector>
+#include <cstddef>
+
+namespace sqlite {
+
+// Specialise for each mapped struct, calling visit(name, member) for every
+// mapped member. Object is T when decoding and const T when binding.
+//
+//     template<> struct mapping<employee> {
+//         template<typename Object, typename Visitor>
+//         static void members(Object &e, Visitor &visit) {
+//             visit("id", e.id);
+//             visit("name", e.name);
+//         }
+//     };
+template<typename T>
+struct mapping;
+
+namespace detail {
+
+template<typename T>
+struct mapping_key {
+    static const char parameters;
+    static const char columns;
+};
+
+template<typename T> const char mapping_key<T>::parameters = 0;
+template<typename T> const char mapping_key<T>::columns = 0;
+
+class member_names {
+public:
+    template<typename Member>
+    void operator()(const char *name, const Member &) { names.push_back(name); }
+
+    std::vector<const char *> names;
+};
+
+class member_binder {
+public:
+    member_binder(statement &stmt, const std::vector<int> &indices):
+        stmt(stmt), indices(indices) {}
+
+    template<typename Member>
+    void operator()(const char *, const Member &member) {
+        int index(indices[next++]);
+        if (index)
+            stmt.bind(std::size_t(index), member);
+    }
+
+private:
+    statement &stmt;
+    const std::vector<int> &indices;
+    std::size_t next = 0;
+};
+
+class member_decoder {
+public:
+    member_decoder(
+            const std::shared_ptr<sqlite3_stmt> &stmt,
+            const std::vector<int> &indices
+    ): stmt(stmt), indices(indices) {}
+
+    template<typename Member>
+    void operator()(const char *, Member &member) {
+        member = field(stmt, indices[next++]).as<Member>();
+    }
+
+private:
+    const std::shared_ptr<sqlite3_stmt> &stmt;
+    const std::vector<int> &indices;
+    std::size_t next = 0;
+};
+
+} // namespace detail
+
+template<typename T>
+void statement::bind(const T &object) {
+    const void *key(&detail::mapping_key<T>::parameters);
+    const std::vector<int> *parameters(indices->find(key));
+    if (! parameters) {
+        detail::member_names names;
+        mapping<T>::members(object, names);
+        parameters = &resolve_parameters(key, names.names);
+    }
+    detail::member_binder binder(*this, *parameters);
+    mapping<T>::members(object, binder);
+}
+
+template<typename T>
+T row::as() const {
+    const void *key(&detail::mapping_key<T>::columns);
+    T object;
+    const std::vector<int> *columns(cached_columns(key));
+    if (! columns) {
+        detail::member_names names;
+        mapping<T>::members(object, names);
+        columns = &resolve_columns(key, names.names);
+    }
+    detail::member_decoder decoder(stmt, *columns);
+    mapping<T>::members(object, decoder);
+    return object;
+}
+
+} // namespace sqlite
+
+#endif // SQLITE_MAPPING_H
@@ -23,6 +23,8 @@
 
 #include <memory>
 
+#if __cplusplus < 201402L
+
 namespace std {
 
 template<typename T, typename... Args>
@@ -33,4 +35,6 @@ std::unique_ptr<T> make_unique(Args&&... args)
 
 }
 
+#endif
+
 #endif // MEMORY_H
@@ -0,0 +1,86 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "memdb.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <fstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sqlite {
+
+memdb_image::memdb_image(const void *data, const std::size_t &size):
+    length(size) {
+    if (! size)
+        return;
+    auto copy(static_cast<unsigned char *>(sqlite3_malloc64(size)));
+    if (! copy)
+        throw error(SQLITE_NOMEM, "while copying a database image");
+    std::memcpy(copy, data, size);
+    bytes.reset(copy, &sqlite3_free);
+}
+
+memdb_image::memdb_image(const std::string &path) {
+    int fd(::open(path.c_str(), O_RDONLY));
+    if (fd < 0)
+        throw error("unable to open database image '" + path + "'");
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw error("unable to determine the size of '" + path + "'");
+    }
+    length = info.st_size;
+    if (length) {
+        void *mapping(::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw error("unable to map '" + path + "' into memory");
+        }
+        std::size_t mapped(length);
+        bytes.reset(
+            static_cast<const unsigned char *>(mapping),
+            [mapped](const unsigned char *data) {
+                ::munmap(const_cast<unsigned char *>(data), mapped);
+            }
+        );
+    }
+    ::close(fd);
+}
+
+memdb_image::memdb_image(
+        const std::shared_ptr<const unsigned char> &bytes,
+        const std::size_t &size
+):
+    bytes(bytes),
+    length(size) {}
+
+void memdb_image::save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(data()), length);
+    file.close();
+    if (! file)
+        throw error("unable to write database image '" + path + "'");
+}
+
+} // namespace sqlite
@@ -0,0 +1,54 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_MEMDB_H
+#define SQLITE_MEMDB_H
+
+#include <memory>
+#include <string>
+#include <cstddef>
+
+namespace sqlite {
+
+class memdb_image {
+public:
+    memdb_image() = default;
+    memdb_image(const void *data, const std::size_t &size);
+    explicit memdb_image(const std::string &path);
+
+    const unsigned char* data() const { return bytes.get(); }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    void save(const std::string &path) const;
+
+private:
+    friend class database;
+
+    memdb_image(
+            const std::shared_ptr<const unsigned char> &bytes,
+            const std::size_t &size
+    );
+
+private:
+    std::shared_ptr<const unsigned char> bytes;
+    std::size_t length = 0;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_MEMDB_H
@@ -0,0 +1,231 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "paged_cursor.hpp"
+#include "expected.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cctype>
+#include <cassert>
+#include <cstring>
+
+namespace sqlite {
+
+namespace {
+
+const char limit_parameter[] = ":paged_cursor_limit";
+
+std::string key_parameter(const std::size_t &index) {
+    return ":paged_cursor_key_" + std::to_string(index + 1);
+}
+
+std::string page_sql(
+        std::string query,
+        const std::vector<std::string> &keys,
+        const bool &seek
+) {
+    while (! query.empty() && (std::isspace(query.back()) || query.back() == ';'))
+        query.pop_back();
+    std::string columns, parameters;
+    for (std::size_t i(0); i < keys.size(); ++i) {
+        columns += (i ? ", " : "") + detail::quote_identifier(keys[i]);
+        parameters += (i ? ", " : "") + key_parameter(i);
+    }
+    std::string sql("SELECT * FROM (" + query + ")");
+    if (seek)
+        sql += " WHERE (" + columns + ") > (" + parameters + ")";
+    return sql + " ORDER BY " + columns + " LIMIT " + limit_parameter + ";";
+}
+
+// FNV-1a over the query and keys, so a token is only accepted by a cursor
+// over the same query
+uint64_t fingerprint_of(
+        const std::string &query,
+        const std::vector<std::string> &keys
+) {
+    uint64_t hash(14695981039346656037ull);
+    auto mix([&hash](const std::string &text) {
+        for (unsigned char c : text)
+            hash = (hash ^ c) * 1099511628211ull;
+        hash = (hash ^ 0xff) * 1099511628211ull;
+    });
+    mix(query);
+    for (const std::string &key : keys)
+        mix(key);
+    return hash;
+}
+
+void put_integer(std::string &bytes, uint64_t number) {
+    for (int i(0); i < 8; ++i, number >>= 8)
+        bytes += static_cast<char>(number & 0xff);
+}
+
+uint64_t get_integer(const std::string &bytes, std::size_t &offset) {
+    if (offset + 8 > bytes.size())
+        throw error("truncated paged_cursor resume token");
+    uint64_t number(0);
+    for (int i(7); i >= 0; --i)
+        number = (number << 8) | static_cast<unsigned char>(bytes[offset + i]);
+    offset += 8;
+    return number;
+}
+
+std::string to_hex(const std::string &bytes) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (unsigned char c : bytes) {
+        hex += digits[c >> 4];
+        hex += digits[c & 0x0f];
+    }
+    return hex;
+}
+
+std::string from_hex(const std::string &hex) {
+    auto nibble([](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        throw error("malformed paged_cursor resume token");
+    });
+    if (hex.size() % 2)
+        throw error("malformed paged_cursor resume token");
+    std::string bytes;
+    for (std::size_t i(0); i < hex.size(); i += 2)
+        bytes += static_cast<char>(nibble(hex[i]) << 4 | nibble(hex[i + 1]));
+    return bytes;
+}
+
+} // namespace
+
+paged_cursor::paged_cursor(
+        database &db,
+        const std::string &query,
+        const std::vector<std::string> &key_columns,
+        const std::size_t &page_size
+):
+    keys(key_columns),
+    page_size(page_size),
+    fingerprint(fingerprint_of(query, key_columns)),
+    first(db.prepare_statement(page_sql(query, key_columns, false))),
+    next(db.prepare_statement(page_sql(query, key_columns, true))) {
+    assert(! keys.empty() && "paged_cursor requires at least one key column");
+    assert(page_size > 0 && "paged_cursor requires a positive page size");
+    first.bind(limit_parameter, static_cast<int64_t>(page_size));
+    next.bind(limit_parameter, static_cast<int64_t>(page_size));
+}
+
+std::vector<value_row> paged_cursor::next_page() {
+    if (finished)
+        return std::vector<value_row>();
+    if (last_key.empty())
+        return fetch(first);
+    for (std::size_t i(0); i < last_key.size(); ++i)
+        next.bind(key_parameter(i), last_key[i]);
+    return fetch(next);
+}
+
+std::vector<value_row> paged_cursor::fetch(statement &page) {
+    sqlite3_stmt *stmt(page.stmt.get());
+    (void) sqlite3_reset(stmt);
+    auto names(column_names(stmt));
+    std::vector<value_row> rows;
+    rows.reserve(page_size);
+    int status;
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        rows.emplace_back();
+        rows.back().assign_columns(stmt, names);
+    }
+    (void) sqlite3_reset(stmt);
+    if (status != SQLITE_DONE)
+        error_code(status, page.stmt).raise();
+    if (rows.size() < page_size)
+        finished = true;
+    if (rows.empty())
+        return rows;
+    std::vector<value> position;
+    for (const std::string &key : keys) {
+        position.push_back(rows.back()[key]);
+        if (position.back().is_null())
+            throw error("paged_cursor key column " + key + " is null");
+    }
+    last_key = std::move(position);
+    return rows;
+}
+
+std::string paged_cursor::resume_token() const {
+    std::string bytes(1, finished ? 'F' : 'P');
+    put_integer(bytes, fingerprint);
+    for (const value &key : last_key) {
+        switch (key.type()) {
+        case value_type::integer:
+            bytes += 'i';
+            put_integer(bytes, key.as<int64_t>());
+            break;
+        case value_type::real: {
+            double real(key.as<double>());
+            uint64_t bits;
+            std::memcpy(&bits, &real, sizeof(bits));
+            bytes += 'r';
+            put_integer(bytes, bits);
+            break;
+        }
+        default:
+            bytes += key.type() == value_type::text ? 't' : 'b';
+            put_integer(bytes, key.size());
+            bytes.append(key.data(), key.size());
+        }
+    }
+    return to_hex(bytes);
+}
+
+void paged_cursor::resume(const std::string &token) {
+    auto bytes(from_hex(token));
+    std::size_t offset(1);
+    if (bytes.empty() || (bytes[0] != 'F' && bytes[0] != 'P'))
+        throw error("malformed paged_cursor resume token");
+    if (get_integer(bytes, offset) != fingerprint)
+        throw error("paged_cursor resume token belongs to a different query");
+    std::vector<value> position;
+    while (offset < bytes.size()) {
+        char type(bytes[offset++]);
+        uint64_t number(get_integer(bytes, offset));
+        if (type == 'i') {
+            position.emplace_back(static_cast<int64_t>(number));
+        } else if (type == 'r') {
+            double real;
+            std::memcpy(&real, &number, sizeof(real));
+            position.emplace_back(real);
+        } else if ((type == 't' || type == 'b') && number <= bytes.size() - offset) {
+            position.emplace_back(
+                type == 't' ? value_type::text : value_type::blob,
+                bytes.data() + offset,
+                number
+            );
+            offset += number;
+        } else {
+            throw error("malformed paged_cursor resume token");
+        }
+    }
+    if (! position.empty() && position.size() != keys.size())
+        throw error("malformed paged_cursor resume token");
+    last_key = std::move(position);
+    finished = bytes[0] == 'F';
+}
+
+} // namespace sqlite
@@ -0,0 +1,76 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_PAGED_CURSOR_H
+#define SQLITE_PAGED_CURSOR_H
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "value.hpp"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace sqlite {
+
+// Pages through a query in ascending order of its key columns by seeking
+// past the last key seen, so every page costs the same however deep it is.
+// The key columns must be non-null and unique together.
+class paged_cursor {
+public:
+    paged_cursor(
+            database &db,
+            const std::string &query,
+            const std::vector<std::string> &key_columns,
+            const std::size_t &page_size = 100
+    );
+    paged_cursor(const paged_cursor &other) = delete;
+    paged_cursor(paged_cursor &&other) = default;
+
+    paged_cursor& operator=(const paged_cursor &other) = delete;
+
+    template<typename T>
+    void bind(const std::string &parameter, const T &value) {
+        first.bind(parameter, value);
+        next.bind(parameter, value);
+    }
+
+    std::vector<value_row> next_page();
+    bool exhausted() const { return finished; }
+    const std::vector<value>& position() const { return last_key; }
+
+    std::string resume_token() const;
+    void resume(const std::string &token);
+
+private:
+    std::vector<value_row> fetch(statement &page);
+
+private:
+    std::vector<std::string> keys;
+    std::size_t page_size;
+    uint64_t fingerprint;
+    statement first;
+    statement next;
+    std::vector<value> last_key;
+    bool finished = false;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_PAGED_CURSOR_H
@@ -0,0 +1,73 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "plan.hpp"
+
+namespace sqlite {
+
+namespace {
+
+bool contains(const std::string &text, const char *fragment) {
+    return text.find(fragment) != std::string::npos;
+}
+
+std::vector<plan_step> children_of(
+        const int &parent,
+        const std::vector<plan_step> &steps
+) {
+    std::vector<plan_step> children;
+    for (const plan_step &step : steps) {
+        if (step.parent == parent && step.id != parent) {
+            children.push_back(step);
+            children.back().children = children_of(step.id, steps);
+        }
+    }
+    return children;
+}
+
+void collect_full_scans(
+        const std::vector<plan_step> &steps,
+        std::vector<std::string> &scans
+) {
+    for (const plan_step &step : steps) {
+        if (step.is_full_scan())
+            scans.push_back(step.detail);
+        collect_full_scans(step.children, scans);
+    }
+}
+
+}
+
+bool plan_step::is_full_scan() const {
+    if (detail.compare(0, 5, "SCAN ") != 0)
+        return false;
+    return ! contains(detail, " USING ")
+        && ! contains(detail, "CONSTANT ROW")
+        && ! contains(detail, "SUBQUERY")
+        && ! contains(detail, "(subquery")
+        && ! contains(detail, "VIRTUAL TABLE");
+}
+
+query_plan::query_plan(const std::vector<plan_step> &steps):
+    roots(children_of(0, steps)) {}
+
+std::vector<std::string> query_plan::full_scans() const {
+    std::vector<std::string> scans;
+    collect_full_scans(roots, scans);
+    return scans;
+}
+
+} // namespace sqlite
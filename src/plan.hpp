@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_PLAN_H
+#define SQLITE_PLAN_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+namespace sqlite {
+
+struct plan_step {
+    int id = 0;
+    int parent = 0;
+    std::string detail;
+    std::vector<plan_step> children;
+
+    bool is_full_scan() const;
+};
+
+class query_plan {
+public:
+    query_plan(const std::vector<plan_step> &steps);
+
+    const std::vector<plan_step>& steps() const { return roots; }
+    std::vector<std::string> full_scans() const;
+    bool has_full_scan() const { return ! full_scans().empty(); }
+
+private:
+    std::vector<plan_step> roots;
+};
+
+struct plan_warning {
+    std::string sql;
+    std::string detail;
+    std::size_t full_scan_steps = 0;
+};
+
+typedef std::function<void(const plan_warning &)> scan_callback;
+
+} // namespace sqlite
+
+#endif // SQLITE_PLAN_H
@@ -0,0 +1,215 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "prefetch.hpp"
+#include "affinity.hpp"
+
+#include <sqlite3.h>
+
+#include <cassert>
+
+namespace sqlite {
+
+namespace {
+
+// Yields this many times before blocking, a stall is usually short
+const int spin_limit(64);
+
+std::size_t ring_capacity(const std::size_t &depth) {
+    std::size_t capacity(2);
+    while (capacity < depth)
+        capacity <<= 1;
+    return capacity;
+}
+
+}
+
+prefetched_result::prefetched_result(
+        result &&results,
+        const std::size_t &depth
+):
+    results(std::move(results)),
+    ring(ring_capacity(depth)),
+    mask(ring.size() - 1),
+    head(0),
+    tail(0),
+    finished(false),
+    stopping(false),
+    producer_stalls(0),
+    consumer_stalls(0),
+    producer_waiting(false),
+    consumer_waiting(false),
+    producer(&prefetched_result::produce, this) {}
+
+prefetched_result::~prefetched_result() {
+    stopping.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    space_available.notify_one();
+    producer.join();
+}
+
+prefetched_result::const_iterator prefetched_result::begin() {
+    return {this};
+}
+
+prefetched_result::const_iterator prefetched_result::end() {
+    return {nullptr};
+}
+
+prefetch_statistics prefetched_result::statistics() const {
+    prefetch_statistics stats;
+    stats.depth = ring.size();
+    stats.rows = tail.load(std::memory_order_acquire);
+    stats.producer_stalls = producer_stalls.load(std::memory_order_relaxed);
+    stats.consumer_stalls = consumer_stalls.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void prefetched_result::produce() {
+    sqlite3 *db(sqlite3_db_handle(results.stmt.get()));
+    auto owner(detail::hand_over_connection(db, std::this_thread::get_id()));
+    try {
+        sqlite3_stmt *stmt(results.stmt.get());
+        auto names(column_names(stmt));
+        std::size_t next(tail.load(std::memory_order_relaxed));
+        for (auto row(results.begin()), end(results.end()); row != end; ++row) {
+            if (ring_full(next)) {
+                producer_stalls.fetch_add(1, std::memory_order_relaxed);
+                wait_for_space(next);
+            }
+            if (stopping.load(std::memory_order_acquire))
+                break;
+            ring[next & mask].assign_columns(stmt, names);
+            tail.store(++next);
+            if (consumer_waiting.load()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                row_available.notify_one();
+            }
+        }
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    if (owner != std::thread::id())
+        (void) detail::hand_over_connection(db, owner);
+    finished.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    row_available.notify_one();
+}
+
+bool prefetched_result::ring_full(const std::size_t &next) const {
+    return next - head.load() == ring.size();
+}
+
+// The waiting flags are set before the final check and read after each
+// index update, so one side always sees the other and no wakeup is lost
+void prefetched_result::wait_for_space(const std::size_t &next) {
+    for (int spin(0); ring_full(next); ++spin) {
+        if (stopping.load(std::memory_order_acquire))
+            return;
+        if (spin < spin_limit) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        producer_waiting.store(true);
+        space_available.wait(lock, [this, &next] {
+            return ! ring_full(next) || stopping.load(std::memory_order_acquire);
+        });
+        producer_waiting.store(false);
+    }
+}
+
+bool prefetched_result::wait_for_row() {
+    std::size_t current(head.load(std::memory_order_relaxed));
+    if (current != tail.load(std::memory_order_acquire))
+        return true;
+    if (! finished.load(std::memory_order_acquire))
+        consumer_stalls.fetch_add(1, std::memory_order_relaxed);
+    for (int spin(0); current == tail.load(std::memory_order_acquire); ++spin) {
+        if (finished.load(std::memory_order_acquire)) {
+            if (current != tail.load(std::memory_order_acquire))
+                return true;
+            if (failure)
+                std::rethrow_exception(failure);
+            return false;
+        }
+        if (spin < spin_limit) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        consumer_waiting.store(true);
+        row_available.wait(lock, [this, &current] {
+            return current != tail.load()
+                || finished.load(std::memory_order_acquire);
+        });
+        consumer_waiting.store(false);
+    }
+    return true;
+}
+
+const value_row& prefetched_result::current_row() const {
+    return ring[head.load(std::memory_order_relaxed) & mask];
+}
+
+void prefetched_result::release_row() {
+    head.fetch_add(1);
+    if (producer_waiting.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        space_available.notify_one();
+    }
+}
+
+prefetched_result::const_iterator::const_iterator(prefetched_result *owner):
+    owner(owner) {}
+
+bool prefetched_result::const_iterator::at_end() const {
+    return ! owner || ! owner->wait_for_row();
+}
+
+bool prefetched_result::const_iterator::operator==(
+        const const_iterator &other
+) const {
+    return at_end() == other.at_end();
+}
+
+bool prefetched_result::const_iterator::operator!=(
+        const const_iterator &other
+) const {
+    return ! (*this == other);
+}
+
+prefetched_result::const_iterator&
+prefetched_result::const_iterator::operator++() {
+    assert(! at_end() && "attempt to increment past last result");
+    owner->release_row();
+    return *this;
+}
+
+const value_row& prefetched_result::const_iterator::operator*() const {
+    assert(! at_end() && "attempt to dereference past last result");
+    return owner->current_row();
+}
+
+const value_row* prefetched_result::const_iterator::operator->() const {
+    return &**this;
+}
+
+} // namespace sqlite
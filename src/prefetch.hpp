@@ -0,0 +1,104 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_PREFETCH_H
+#define SQLITE_PREFETCH_H
+
+#include "result.hpp"
+#include "value.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <exception>
+#include <condition_variable>
+
+namespace sqlite {
+
+struct prefetch_statistics {
+    std::size_t depth = 0;
+    std::size_t rows = 0;
+    std::size_t producer_stalls = 0;
+    std::size_t consumer_stalls = 0;
+};
+
+// Steps the query on a producer thread, which owns a multi_thread connection
+// until the rows run out or the prefetched_result is destroyed. The
+// connection mustn't be used by anything else until then.
+class prefetched_result {
+public:
+    class const_iterator {
+    public:
+        const_iterator(prefetched_result *owner);
+
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+        const_iterator& operator++();
+        const value_row& operator*() const;
+        const value_row* operator->() const;
+
+    private:
+        bool at_end() const;
+
+    private:
+        prefetched_result *owner;
+    };
+
+public:
+    prefetched_result(result &&results, const std::size_t &depth = 256);
+    prefetched_result(const prefetched_result &other) = delete;
+    ~prefetched_result();
+
+    prefetched_result& operator=(const prefetched_result &other) = delete;
+
+    const_iterator begin();
+    const_iterator end();
+
+    prefetch_statistics statistics() const;
+
+private:
+    void produce();
+    bool ring_full(const std::size_t &next) const;
+    void wait_for_space(const std::size_t &next);
+    bool wait_for_row();
+    const value_row& current_row() const;
+    void release_row();
+
+private:
+    result results;
+    std::vector<value_row> ring;
+    const std::size_t mask;
+    std::atomic<std::size_t> head;
+    std::atomic<std::size_t> tail;
+    std::atomic<bool> finished;
+    std::atomic<bool> stopping;
+    std::atomic<std::size_t> producer_stalls;
+    std::atomic<std::size_t> consumer_stalls;
+    std::atomic<bool> producer_waiting;
+    std::atomic<bool> consumer_waiting;
+    std::mutex mutex;
+    std::condition_variable space_available;
+    std::condition_variable row_available;
+    std::exception_ptr failure;
+    std::thread producer;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_PREFETCH_H
@@ -15,47 +15,309 @@
 */
 
 #include "result.hpp"
+#include "affinity.hpp"
 
 #include <sqlite3.h>
 
+#include <ostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <cassert>
 
 namespace sqlite {
 
-namespace {
+namespace detail {
 
 bool step_result(const std::shared_ptr<sqlite3_stmt> &stmt) {
     assert(stmt && "attempt to step null sqlite3_stmt");
+    detail::check_affinity(sqlite3_db_handle(stmt.get()));
     auto status(sqlite3_step(stmt.get()));
     switch (status) {
-    case SQLITE_DONE:   return true;
-    case SQLITE_ROW:    return false;
-    case SQLITE_LOCKED: // fall-through
-    case SQLITE_BUSY:   throw transaction_failed(status);
-    default:            throw error(stmt);
+    case SQLITE_DONE:      return true;
+    case SQLITE_ROW:       return false;
+    case SQLITE_LOCKED:    // fall-through
+    case SQLITE_BUSY:      throw transaction_failed(status);
+    case SQLITE_INTERRUPT: throw interrupted(status);
+    default:               throw error(stmt);
     }
 }
 
+} // namespace detail
+
+namespace {
+
 bool iterator_end(true);
 
+class output_buffer {
+public:
+    output_buffer(std::ostream &sink): sink(sink), buffer(1 << 16) {}
+
+    void put(const char c) {
+        if (used == buffer.size())
+            flush();
+        buffer[used++] = c;
+    }
+
+    void append(const char *data, std::size_t size) {
+        while (size) {
+            if (used == buffer.size())
+                flush();
+            std::size_t chunk(std::min(size, buffer.size() - used));
+            std::memcpy(&buffer[used], data, chunk);
+            used += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+
+    void append(const std::string &text) { append(text.data(), text.size()); }
+
+    void flush() {
+        sink.write(buffer.data(), used);
+        used = 0;
+        if (! sink)
+            throw error("unable to write results to output stream");
+    }
+
+private:
+    std::ostream &sink;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+};
+
+class string_output {
+public:
+    string_output(std::string &text): text(text) {}
+
+    void put(const char c) { text.push_back(c); }
+    void append(const char *data, std::size_t size) { text.append(data, size); }
+
+private:
+    std::string &text;
+};
+
+const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void write_integer(output_buffer &out, const sqlite3_int64 value) {
+    char digits[20];
+    char *end(digits + sizeof(digits));
+    char *first(end);
+    std::uint64_t magnitude(value < 0 ? 0 - std::uint64_t(value) : value);
+    while (magnitude >= 100) {
+        const char *pair(digit_pairs + (magnitude % 100) * 2);
+        magnitude /= 100;
+        *--first = pair[1];
+        *--first = pair[0];
+    }
+    if (magnitude >= 10) {
+        const char *pair(digit_pairs + magnitude * 2);
+        *--first = pair[1];
+        *--first = pair[0];
+    } else {
+        *--first = static_cast<char>('0' + magnitude);
+    }
+    if (value < 0)
+        out.put('-');
+    out.append(first, end - first);
+}
+
+void write_real(
+        output_buffer &out,
+        const double value,
+        const char *infinity,
+        const char *not_a_number
+) {
+    if (std::isnan(value)) {
+        out.append(not_a_number, std::strlen(not_a_number));
+        return;
+    }
+    if (std::isinf(value)) {
+        if (value < 0)
+            out.put('-');
+        out.append(infinity, std::strlen(infinity));
+        return;
+    }
+    if (value == std::trunc(value) && std::fabs(value) < 9007199254740992.0) {
+        write_integer(out, static_cast<sqlite3_int64>(value));
+        out.append(".0", 2);
+        return;
+    }
+    char text[32];
+    int length(std::snprintf(text, sizeof(text), "%.15g", value));
+    if (std::strtod(text, nullptr) != value)
+        length = std::snprintf(text, sizeof(text), "%.17g", value);
+    out.append(text, length);
+}
+
+void write_hex(output_buffer &out, const void *data, const std::size_t size) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const unsigned char *bytes(static_cast<const unsigned char *>(data));
+    for (std::size_t i(0); i < size; ++i) {
+        out.put(hex_digits[bytes[i] >> 4]);
+        out.put(hex_digits[bytes[i] & 0x0f]);
+    }
+}
+
+bool needs_csv_quotes(const char *text, const std::size_t size) {
+    for (const char *c(text); c != text + size; ++c) {
+        if (*c == ',' || *c == '"' || *c == '\n' || *c == '\r')
+            return true;
+    }
+    return false;
+}
+
+void write_csv_text(output_buffer &out, const char *text, const std::size_t size) {
+    if (! needs_csv_quotes(text, size)) {
+        out.append(text, size);
+        return;
+    }
+    out.put('"');
+    const char *run(text);
+    const char *end(text + size);
+    for (const char *c(text); c != end; ++c) {
+        if (*c == '"') {
+            out.append(run, c - run + 1);
+            out.put('"');
+            run = c + 1;
+        }
+    }
+    out.append(run, end - run);
+    out.put('"');
+}
+
+template<typename Output>
+void write_json_text(Output &out, const char *text, const std::size_t size) {
+    static const char hex_digits[] = "0123456789abcdef";
+    out.put('"');
+    const char *run(text);
+    const char *end(text + size);
+    for (const char *c(text); c != end; ++c) {
+        unsigned char character(*c);
+        if (character >= 0x20 && character != '"' && character != '\\')
+            continue;
+        out.append(run, c - run);
+        run = c + 1;
+        out.put('\\');
+        switch (character) {
+        case '"':  out.put('"');  break;
+        case '\\': out.put('\\'); break;
+        case '\n': out.put('n');  break;
+        case '\r': out.put('r');  break;
+        case '\t': out.put('t');  break;
+        case '\b': out.put('b');  break;
+        case '\f': out.put('f');  break;
+        default:
+            out.append("u00", 3);
+            out.put(hex_digits[character >> 4]);
+            out.put(hex_digits[character & 0x0f]);
+        }
+    }
+    out.append(run, end - run);
+    out.put('"');
+}
+
+void write_csv_field(output_buffer &out, sqlite3_stmt *stmt, const int index) {
+    switch (sqlite3_column_type(stmt, index)) {
+    case SQLITE_INTEGER:
+        write_integer(out, sqlite3_column_int64(stmt, index));
+        break;
+    case SQLITE_FLOAT:
+        write_real(out, sqlite3_column_double(stmt, index), "Inf", "");
+        break;
+    case SQLITE_TEXT: {
+        const char *text(reinterpret_cast<const char *>(
+            sqlite3_column_text(stmt, index)
+        ));
+        write_csv_text(out, text, sqlite3_column_bytes(stmt, index));
+        break;
+    }
+    case SQLITE_BLOB: {
+        const void *data(sqlite3_column_blob(stmt, index));
+        write_hex(out, data, sqlite3_column_bytes(stmt, index));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void write_json_field(output_buffer &out, sqlite3_stmt *stmt, const int index) {
+    switch (sqlite3_column_type(stmt, index)) {
+    case SQLITE_INTEGER:
+        write_integer(out, sqlite3_column_int64(stmt, index));
+        break;
+    case SQLITE_FLOAT:
+        write_real(out, sqlite3_column_double(stmt, index), "9e999", "null");
+        break;
+    case SQLITE_TEXT: {
+        const char *text(reinterpret_cast<const char *>(
+            sqlite3_column_text(stmt, index)
+        ));
+        write_json_text(out, text, sqlite3_column_bytes(stmt, index));
+        break;
+    }
+    case SQLITE_BLOB: {
+        const void *data(sqlite3_column_blob(stmt, index));
+        out.put('"');
+        write_hex(out, data, sqlite3_column_bytes(stmt, index));
+        out.put('"');
+        break;
+    }
+    default:
+        out.append("null", 4);
+        break;
+    }
+}
+
+std::vector<std::string> json_keys(sqlite3_stmt *stmt) {
+    int column_count(sqlite3_column_count(stmt));
+    std::vector<std::string> keys(column_count);
+    for (int i(0); i < column_count; ++i) {
+        string_output key(keys[i]);
+        key.put(i == 0 ? '{' : ',');
+        const char *name(sqlite3_column_name(stmt, i));
+        write_json_text(key, name, std::strlen(name));
+        key.put(':');
+    }
+    return keys;
+}
+
 }
 
 result::result(const std::shared_ptr<sqlite3_stmt> &statement):
         stmt(statement) {
     assert(statement && "null sqlite3_stmt provided");
-    end_reached = step_result(stmt);
+    end_reached = detail::step_result(stmt);
+}
+
+result::result(
+        const std::shared_ptr<sqlite3_stmt> &statement,
+        const bool &at_end
+): stmt(statement), end_reached(at_end) {
+    assert(statement && "null sqlite3_stmt provided");
 }
 
 result::result(result &&other) {
     assert(&other != this && "attempt to move into self");
     stmt = std::move(other.stmt);
     end_reached = other.end_reached;
+    column_indices = std::move(other.column_indices);
 }
 
 result& result::operator=(result &&other) {
     assert(&other != this && "attempt to move into self");
     stmt = std::move(other.stmt);
     end_reached = other.end_reached;
+    column_indices = std::move(other.column_indices);
     return *this;
 }
 
@@ -65,46 +327,77 @@ std::size_t result::row_modification_count() const {
     return sqlite3_stmt_readonly(stmt.get()) ? 0 : sqlite3_changes(db);
 }
 
-result::const_iterator result::begin() const {
-    return {stmt, end_reached};
-}
-
-result::const_iterator result::end() const {
-    return {stmt, iterator_end};
-}
-
-result::const_iterator::const_iterator(
-        const std::shared_ptr<sqlite3_stmt> &statement,
-        bool &at_end
-): stmt(statement), end_reached(at_end), current_row(statement) {
-    assert(statement && "null sqlite3_stmt provided");
+expected<bool> result::try_step() {
+    assert(stmt && "try_step() called on null sqlite::result");
+    if (end_reached)
+        return false;
+    auto status(sqlite3_step(stmt.get()));
+    if (status == SQLITE_ROW)
+        return true;
+    end_reached = true;
+    if (status == SQLITE_DONE)
+        return false;
+    return error_code(status, stmt);
 }
 
-bool result::const_iterator::operator==(
-        const result::const_iterator &other
-) const {
-    return stmt == other.stmt && end_reached == other.end_reached;
+std::size_t result::write_csv(std::ostream &sink, bool include_header) const {
+    assert(stmt && "write_csv() called on null sqlite::result");
+    output_buffer out(sink);
+    int column_count(sqlite3_column_count(stmt.get()));
+    if (include_header) {
+        for (int i(0); i < column_count; ++i) {
+            if (i)
+                out.put(',');
+            const char *name(sqlite3_column_name(stmt.get(), i));
+            write_csv_text(out, name, std::strlen(name));
+        }
+        out.put('\n');
+    }
+    std::size_t rows(0);
+    for (; ! end_reached; end_reached = detail::step_result(stmt), ++rows) {
+        for (int i(0); i < column_count; ++i) {
+            if (i)
+                out.put(',');
+            write_csv_field(out, stmt.get(), i);
+        }
+        out.put('\n');
+    }
+    out.flush();
+    return rows;
 }
 
-bool result::const_iterator::operator!=(
-        const result::const_iterator &other
-) const {
-    return ! (*this == other);
+std::size_t result::write_jsonl(std::ostream &sink) const {
+    assert(stmt && "write_jsonl() called on null sqlite::result");
+    output_buffer out(sink);
+    std::vector<std::string> keys(json_keys(stmt.get()));
+    std::size_t rows(0);
+    for (; ! end_reached; end_reached = detail::step_result(stmt), ++rows) {
+        for (std::size_t i(0); i < keys.size(); ++i) {
+            out.append(keys[i]);
+            write_json_field(out, stmt.get(), i);
+        }
+        out.append(keys.empty() ? "{}\n" : "}\n", keys.empty() ? 3 : 2);
+    }
+    out.flush();
+    return rows;
 }
 
-result::const_iterator& result::const_iterator::operator++() {
-    assert(!end_reached && "attempt to increment past last result");
-    end_reached = step_result(stmt);
-    current_row = stmt;
-    return *this;
+result::const_iterator result::begin() const {
+    if (! column_indices)
+        column_indices = std::make_shared<index_cache>();
+    return {stmt, end_reached, column_indices};
 }
 
-const row& result::const_iterator::operator*() const {
-    return current_row;
+result::const_iterator result::end() const {
+    return {stmt, iterator_end};
 }
 
-const row* result::const_iterator::operator->() const {
-    return &current_row;
+result::const_iterator::const_iterator(
+        const std::shared_ptr<sqlite3_stmt> &statement,
+        bool &at_end,
+        const std::shared_ptr<index_cache> &column_indices
+): stmt(statement), end_reached(at_end), current_row(statement, column_indices) {
+    assert(statement && "null sqlite3_stmt provided");
 }
 
 } // namespace sqlite
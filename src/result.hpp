@@ -19,17 +19,34 @@
 
 #include "row.hpp"
 #include "error.hpp"
+#include "expected.hpp"
 
+#include <iosfwd>
 #include <memory>
+#include <cassert>
 #include <cstddef>
 
-struct sqlite3_stmt;
-
 namespace sqlite {
 
+class statement;
+
+namespace detail {
+
+// Steps the statement, returning true once it is done
+bool step_result(const std::shared_ptr<sqlite3_stmt> &stmt);
+
+} // namespace detail
+
 class transaction_failed: public error {
 public:
-    transaction_failed(const int status): error(status) {}
+    transaction_failed(const int status, const std::string &msg = std::string()):
+        error(status, msg) {}
+};
+
+class interrupted: public error {
+public:
+    interrupted(const int status, const std::string &msg = std::string()):
+        error(status, msg) {}
 };
 
 class result
@@ -39,7 +56,8 @@ public:
     public:
         const_iterator(
                 const std::shared_ptr<sqlite3_stmt> &statement,
-                bool &at_end
+                bool &at_end,
+                const std::shared_ptr<index_cache> &column_indices = nullptr
         );
         const_iterator(const const_iterator &other) = delete;
         const_iterator(const_iterator &&other) = default;
@@ -47,12 +65,20 @@ public:
         const_iterator& operator=(const const_iterator &other) = delete;
         const_iterator& operator=(const_iterator &&other) = default;
 
-        bool operator==(const const_iterator &other) const;
-        bool operator!=(const const_iterator &other) const;
-
-        const_iterator& operator++();
-        const row& operator*() const;
-        const row* operator->() const;
+        bool operator==(const const_iterator &other) const {
+            return stmt == other.stmt && end_reached == other.end_reached;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return ! (*this == other);
+        }
+
+        const_iterator& operator++() {
+            assert(!end_reached && "attempt to increment past last result");
+            end_reached = detail::step_result(stmt);
+            return *this;
+        }
+        const row& operator*() const { return current_row; }
+        const row* operator->() const { return &current_row; }
 
     private:
         std::shared_ptr<sqlite3_stmt> stmt;
@@ -69,13 +95,24 @@ public:
     result& operator=(result &&other);
 
     std::size_t row_modification_count() const;
+    expected<bool> try_step();
+
+    std::size_t write_csv(std::ostream &sink, bool include_header = true) const;
+    std::size_t write_jsonl(std::ostream &sink) const;
 
     const_iterator begin() const;
     const_iterator end() const;
 
 private:
+    friend class database;
+    friend class prefetched_result;
+    friend result make_result(const statement &statement);
+
+    result(const std::shared_ptr<sqlite3_stmt> &statement, const bool &at_end);
+
     std::shared_ptr<sqlite3_stmt> stmt;
     mutable bool end_reached = false;
+    mutable std::shared_ptr<index_cache> column_indices;
 };
 
 } // namespace sqlite
@@ -0,0 +1,205 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "result_cache.hpp"
+#include "expected.hpp"
+
+#include <sqlite3.h>
+
+#include <cassert>
+
+namespace sqlite {
+
+namespace {
+
+cached_rows materialize(const std::shared_ptr<sqlite3_stmt> &stmt) {
+    (void) sqlite3_reset(stmt.get());
+    auto names(column_names(stmt.get()));
+    auto rows(std::make_shared<std::vector<value_row>>());
+    int status;
+    while ((status = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        rows->emplace_back();
+        rows->back().assign_columns(stmt.get(), names);
+    }
+    (void) sqlite3_reset(stmt.get());
+    if (status != SQLITE_DONE)
+        error_code(status, stmt).raise();
+    return rows;
+}
+
+std::size_t footprint(const std::string &key, const std::vector<value_row> &rows) {
+    std::size_t bytes(key.size() + sizeof(std::vector<value_row>));
+    for (const value_row &row : rows) {
+        bytes += sizeof(value_row) + row.column_count() * sizeof(value);
+        for (std::size_t i(0); i < row.column_count(); ++i)
+            bytes += row[i].size();
+    }
+    return bytes;
+}
+
+bool is_cacheable(sqlite3_stmt *stmt) {
+    return sqlite3_stmt_readonly(stmt) && sqlite3_column_count(stmt) > 0;
+}
+
+void append_bytes(std::string &key, const void *data, const std::size_t &size) {
+    key.append(static_cast<const char *>(data), size);
+}
+
+// The statement text followed by the exact bytes of every bound value, reals
+// by their bit pattern so values differing in the last digit get their own
+bool cache_key(sqlite3_stmt *stmt, std::string &key) {
+    std::vector<value> parameters;
+    if (! detail::bound_values(stmt, parameters))
+        return false;
+    key = sqlite3_sql(stmt);
+    for (const value &parameter : parameters) {
+        key += '\0';
+        key += static_cast<char>(parameter.type());
+        switch (parameter.type()) {
+        case value_type::integer: {
+            auto integer(parameter.as<int64_t>());
+            append_bytes(key, &integer, sizeof(integer));
+            break;
+        }
+        case value_type::real: {
+            auto real(parameter.as<double>());
+            append_bytes(key, &real, sizeof(real));
+            break;
+        }
+        case value_type::text:  // fall-through
+        case value_type::blob: {
+            uint64_t size(parameter.size());
+            append_bytes(key, &size, sizeof(size));
+            append_bytes(key, parameter.data(), parameter.size());
+            break;
+        }
+        case value_type::null:
+            break;
+        }
+    }
+    return true;
+}
+
+}   // namespace
+
+result_cache::result_cache(database &db, const std::size_t &memory_budget):
+    db(db),
+    connection(db.db),
+    memory_budget(memory_budget),
+    schema_generation(db.schema_generation - 1) {
+    detail::capture_bindings(connection);
+}
+
+result_cache::~result_cache() {
+    detail::release_bindings(connection);
+}
+
+cached_rows result_cache::execute(const statement &statement) {
+    sqlite3_stmt *stmt(statement.stmt.get());
+    assert(stmt && "execute() called on null sqlite::statement");
+    std::string key;
+    // Statements bound before the cache existed can't be told apart
+    if (! is_cacheable(stmt) || ! cache_key(stmt, key)) {
+        ++stats.bypassed;
+        return materialize(statement.stmt);
+    }
+    invalidate_if_changed();
+    auto found(index.find(key));
+    if (found != index.end()) {
+        ++stats.hits;
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->rows;
+    }
+    ++stats.misses;
+    auto rows(materialize(statement.stmt));
+    insert(std::move(key), rows);
+    return rows;
+}
+
+cached_rows result_cache::execute(const std::string &sql) {
+    return execute(statement(db.create_statement(sql)));
+}
+
+void result_cache::clear() {
+    entries.clear();
+    index.clear();
+    stats.entries = 0;
+    stats.bytes = 0;
+}
+
+result_cache_statistics result_cache::statistics() const {
+    return stats;
+}
+
+void result_cache::invalidate_if_changed() {
+    auto versions(current_versions());
+    if (versions == last_versions)
+        return;
+    if (! entries.empty()) {
+        ++stats.invalidations;
+        clear();
+    }
+    last_versions = std::move(versions);
+}
+
+std::vector<int64_t> result_cache::current_versions() {
+    // data_version tracks commits from other connections and schema_version
+    // schema changes in each schema, total_changes our own row changes
+    if (schema_generation != db.schema_generation) {
+        version_queries.clear();
+        for (const std::string &schema : db.schemas()) {
+            auto name(detail::quote_identifier(schema));
+            version_queries.emplace_back(
+                db.create_statement("PRAGMA " + name + ".data_version;")
+            );
+            version_queries.emplace_back(
+                db.create_statement("PRAGMA " + name + ".schema_version;")
+            );
+        }
+        schema_generation = db.schema_generation;
+    }
+    std::vector<int64_t> versions;
+    for (const statement &query : version_queries) {
+        sqlite3_stmt *stmt(query.stmt.get());
+        auto status(sqlite3_step(stmt));
+        versions.push_back(sqlite3_column_int64(stmt, 0));
+        (void) sqlite3_reset(stmt);
+        if (status != SQLITE_ROW)
+            error_code(status, query.stmt).raise();
+    }
+    versions.push_back(sqlite3_total_changes64(db.db));
+    versions.push_back(schema_generation);
+    return versions;
+}
+
+void result_cache::insert(std::string &&key, const cached_rows &rows) {
+    std::size_t bytes(footprint(key, *rows));
+    if (bytes > memory_budget)
+        return;
+    while (stats.bytes + bytes > memory_budget) {
+        stats.bytes -= entries.back().bytes;
+        index.erase(entries.back().key);
+        entries.pop_back();
+        ++stats.evictions;
+    }
+    entries.push_front(entry{std::move(key), rows, bytes});
+    index.emplace(entries.front().key, entries.begin());
+    stats.entries = entries.size();
+    stats.bytes += bytes;
+}
+
+} // namespace sqlite
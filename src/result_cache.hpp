@@ -0,0 +1,94 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_RESULT_CACHE_H
+#define SQLITE_RESULT_CACHE_H
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "value.hpp"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+namespace sqlite {
+
+typedef std::shared_ptr<const std::vector<value_row>> cached_rows;
+
+struct result_cache_statistics {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t bypassed = 0;
+    std::size_t evictions = 0;
+    std::size_t invalidations = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+
+    double hit_rate() const {
+        return hits + misses ? double(hits) / (hits + misses) : 0.0;
+    }
+};
+
+class result_cache {
+public:
+    explicit result_cache(
+            database &db,
+            const std::size_t &memory_budget = 16 * 1024 * 1024
+    );
+    result_cache(const result_cache &other) = delete;
+    ~result_cache();
+
+    result_cache& operator=(const result_cache &other) = delete;
+
+    cached_rows execute(const statement &statement);
+    cached_rows execute(const std::string &sql);
+    void clear();
+
+    result_cache_statistics statistics() const;
+
+private:
+    struct entry {
+        std::string key;
+        cached_rows rows;
+        std::size_t bytes;
+    };
+    typedef std::list<entry>::iterator entry_iterator;
+
+    void invalidate_if_changed();
+    std::vector<int64_t> current_versions();
+    void insert(std::string &&key, const cached_rows &rows);
+
+private:
+    database &db;
+    sqlite3 *connection;
+    const std::size_t memory_budget;
+    std::vector<statement> version_queries;
+    std::size_t schema_generation;
+    std::vector<int64_t> last_versions;
+    std::list<entry> entries;
+    std::unordered_map<std::string, entry_iterator> index;
+    result_cache_statistics stats;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_RESULT_CACHE_H
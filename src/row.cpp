@@ -41,27 +41,52 @@ std::size_t find_column_index(
 
 }
 
+const std::vector<int>* index_cache::find(const void *key) const {
+    for (const auto &entry : entries) {
+        if (entry.first == key)
+            return &entry.second;
+    }
+    return nullptr;
+}
+
+const std::vector<int>& index_cache::insert(
+        const void *key,
+        std::vector<int> indices
+) {
+    entries.emplace_back(key, std::move(indices));
+    return entries.back().second;
+}
+
 row::row(const std::shared_ptr<sqlite3_stmt> &statement): stmt(statement) {
     assert(statement && "received null sqlite3_stmt");
 }
 
-std::size_t row::column_count() const {
-    return sqlite3_column_count(stmt.get());
+row::row(
+        const std::shared_ptr<sqlite3_stmt> &statement,
+        const std::shared_ptr<index_cache> &column_indices
+): stmt(statement), column_indices(column_indices) {
+    assert(statement && "received null sqlite3_stmt");
 }
 
 field row::operator[](const std::string &column_name) const {
     return {stmt, find_column_index(column_name, stmt)};
 }
 
-field row::operator[](const std::size_t &column_index) const {
-    assert(is_valid_index(column_index) && "invalid column index requested");
-    if (! is_valid_index(column_index))
-        throw error("no column at index " + std::to_string(column_index));
-    return {stmt, column_index};
+const std::vector<int>* row::cached_columns(const void *key) const {
+    if (! column_indices)
+        column_indices = std::make_shared<index_cache>();
+    return column_indices->find(key);
 }
 
-bool row::is_valid_index(const std::size_t &index) const {
-    return index < column_count();
+const std::vector<int>& row::resolve_columns(
+        const void *key,
+        const std::vector<const char *> &names
+) const {
+    std::vector<int> indices;
+    indices.reserve(names.size());
+    for (const char *name : names)
+        indices.push_back(find_column_index(name, stmt));
+    return column_indices->insert(key, std::move(indices));
 }
 
 } // namespace sqlite
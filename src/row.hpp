@@ -18,34 +18,70 @@
 #define SQLITE_ROW_H
 
 #include "field.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
 
 #include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cassert>
 #include <cstddef>
 
-struct sqlite3_stmt;
-
 namespace sqlite {
 
+class index_cache {
+public:
+    const std::vector<int>* find(const void *key) const;
+    const std::vector<int>& insert(const void *key, std::vector<int> indices);
+
+private:
+    std::vector<std::pair<const void *, std::vector<int>>> entries;
+};
+
 class row
 {
 public:
     row(const std::shared_ptr<sqlite3_stmt> &statement);
+    row(
+            const std::shared_ptr<sqlite3_stmt> &statement,
+            const std::shared_ptr<index_cache> &column_indices
+    );
     row(const row &other) = default;
     row(row &&other) = default;
 
     row& operator=(const row &other) = default;
     row& operator=(row &&other) = default;
 
-    std::size_t column_count() const;
+    std::size_t column_count() const {
+        return sqlite3_column_count(stmt.get());
+    }
 
     field operator[](const std::string &column_name) const;
-    field operator[](const std::size_t &column_index) const;
+    field operator[](const std::size_t &column_index) const {
+        assert(is_valid_index(column_index) && "invalid column index requested");
+        if (! is_valid_index(column_index))
+            throw error("no column at index " + std::to_string(column_index));
+        return {stmt, column_index};
+    }
+
+    template<typename T>
+    T as() const;
 
 private:
-    bool is_valid_index(const std::size_t &index) const;
+    bool is_valid_index(const std::size_t &index) const {
+        return index < column_count();
+    }
+    const std::vector<int>* cached_columns(const void *key) const;
+    const std::vector<int>& resolve_columns(
+            const void *key,
+            const std::vector<const char *> &names
+    ) const;
 
 private:
     std::shared_ptr<sqlite3_stmt> stmt;
+    mutable std::shared_ptr<index_cache> column_indices;
 };
 
 } // namespace sqlite
@@ -0,0 +1,538 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "similarity.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SQLITE_VECTOR_AVX2
+#endif
+
+namespace sqlite {
+
+namespace {
+
+// Blob pointers carry no alignment guarantee, so the scalar path and the
+// tails of the simd loops read elements through memcpy
+inline float element(const unsigned char *data, const std::size_t &index) {
+    float result;
+    std::memcpy(&result, data + index * sizeof(float), sizeof(float));
+    return result;
+}
+
+struct cosine_terms {
+    double ab = 0.0;
+    double aa = 0.0;
+    double bb = 0.0;
+};
+
+struct kernel_set {
+    const char *name;
+    double (*dot)(const unsigned char *, const unsigned char *, std::size_t);
+    double (*squared_distance)(
+            const unsigned char *,
+            const unsigned char *,
+            std::size_t
+    );
+    cosine_terms (*cosine)(
+            const unsigned char *,
+            const unsigned char *,
+            std::size_t
+    );
+};
+
+double scalar_dot(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    float sum(0.0f);
+    for (std::size_t i(0); i < count; ++i)
+        sum += element(a, i) * element(b, i);
+    return sum;
+}
+
+double scalar_squared_distance(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    float sum(0.0f);
+    for (std::size_t i(0); i < count; ++i) {
+        float difference(element(a, i) - element(b, i));
+        sum += difference * difference;
+    }
+    return sum;
+}
+
+cosine_terms scalar_cosine(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    float ab(0.0f), aa(0.0f), bb(0.0f);
+    for (std::size_t i(0); i < count; ++i) {
+        float x(element(a, i)), y(element(b, i));
+        ab += x * y;
+        aa += x * x;
+        bb += y * y;
+    }
+    cosine_terms terms;
+    terms.ab = ab;
+    terms.aa = aa;
+    terms.bb = bb;
+    return terms;
+}
+
+#if defined(__SSE2__)
+
+inline float horizontal_sum(__m128 sum) {
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+double sse2_dot(const unsigned char *a, const unsigned char *b, std::size_t count) {
+    __m128 sum(_mm_setzero_ps());
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x(_mm_loadu_ps(reinterpret_cast<const float *>(a) + i));
+        __m128 y(_mm_loadu_ps(reinterpret_cast<const float *>(b) + i));
+        sum = _mm_add_ps(sum, _mm_mul_ps(x, y));
+    }
+    float total(horizontal_sum(sum));
+    return total + scalar_dot(a + i * sizeof(float), b + i * sizeof(float), count - i);
+}
+
+double sse2_squared_distance(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    __m128 sum(_mm_setzero_ps());
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4) {
+        __m128 difference(_mm_sub_ps(
+            _mm_loadu_ps(reinterpret_cast<const float *>(a) + i),
+            _mm_loadu_ps(reinterpret_cast<const float *>(b) + i)
+        ));
+        sum = _mm_add_ps(sum, _mm_mul_ps(difference, difference));
+    }
+    float total(horizontal_sum(sum));
+    return total + scalar_squared_distance(
+        a + i * sizeof(float), b + i * sizeof(float), count - i
+    );
+}
+
+cosine_terms sse2_cosine(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    __m128 ab(_mm_setzero_ps()), aa(_mm_setzero_ps()), bb(_mm_setzero_ps());
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x(_mm_loadu_ps(reinterpret_cast<const float *>(a) + i));
+        __m128 y(_mm_loadu_ps(reinterpret_cast<const float *>(b) + i));
+        ab = _mm_add_ps(ab, _mm_mul_ps(x, y));
+        aa = _mm_add_ps(aa, _mm_mul_ps(x, x));
+        bb = _mm_add_ps(bb, _mm_mul_ps(y, y));
+    }
+    auto terms(scalar_cosine(a + i * sizeof(float), b + i * sizeof(float), count - i));
+    terms.ab += horizontal_sum(ab);
+    terms.aa += horizontal_sum(aa);
+    terms.bb += horizontal_sum(bb);
+    return terms;
+}
+
+#endif // __SSE2__
+
+#if defined(SQLITE_VECTOR_AVX2)
+
+// Compiled for avx2 regardless of the target flags and only selected after
+// checking the cpu at runtime
+__attribute__((target("avx2,fma")))
+inline float horizontal_sum(__m256 sum) {
+    __m128 folded(_mm_add_ps(
+        _mm256_castps256_ps128(sum),
+        _mm256_extractf128_ps(sum, 1)
+    ));
+    folded = _mm_add_ps(folded, _mm_movehl_ps(folded, folded));
+    folded = _mm_add_ss(folded, _mm_shuffle_ps(folded, folded, 1));
+    return _mm_cvtss_f32(folded);
+}
+
+__attribute__((target("avx2,fma")))
+double avx2_dot(const unsigned char *a, const unsigned char *b, std::size_t count) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    __m256 even(_mm256_setzero_ps()), odd(_mm256_setzero_ps());
+    std::size_t i(0);
+    for (; i + 16 <= count; i += 16) {
+        even = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), even);
+        odd = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), odd);
+    }
+    for (; i + 8 <= count; i += 8)
+        even = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), even);
+    float total(horizontal_sum(_mm256_add_ps(even, odd)));
+    return total + scalar_dot(a + i * sizeof(float), b + i * sizeof(float), count - i);
+}
+
+__attribute__((target("avx2,fma")))
+double avx2_squared_distance(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    __m256 even(_mm256_setzero_ps()), odd(_mm256_setzero_ps());
+    std::size_t i(0);
+    for (; i + 16 <= count; i += 16) {
+        __m256 first(_mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        __m256 second(_mm256_sub_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+        even = _mm256_fmadd_ps(first, first, even);
+        odd = _mm256_fmadd_ps(second, second, odd);
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256 difference(_mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        even = _mm256_fmadd_ps(difference, difference, even);
+    }
+    float total(horizontal_sum(_mm256_add_ps(even, odd)));
+    return total + scalar_squared_distance(
+        a + i * sizeof(float), b + i * sizeof(float), count - i
+    );
+}
+
+__attribute__((target("avx2,fma")))
+cosine_terms avx2_cosine(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    __m256 ab(_mm256_setzero_ps()), aa(_mm256_setzero_ps()), bb(_mm256_setzero_ps());
+    std::size_t i(0);
+    for (; i + 8 <= count; i += 8) {
+        __m256 first(_mm256_loadu_ps(x + i)), second(_mm256_loadu_ps(y + i));
+        ab = _mm256_fmadd_ps(first, second, ab);
+        aa = _mm256_fmadd_ps(first, first, aa);
+        bb = _mm256_fmadd_ps(second, second, bb);
+    }
+    auto terms(scalar_cosine(a + i * sizeof(float), b + i * sizeof(float), count - i));
+    terms.ab += horizontal_sum(ab);
+    terms.aa += horizontal_sum(aa);
+    terms.bb += horizontal_sum(bb);
+    return terms;
+}
+
+#endif // SQLITE_VECTOR_AVX2
+
+#if defined(__ARM_NEON)
+
+inline float horizontal_sum(float32x4_t sum) {
+    float32x2_t folded(vadd_f32(vget_low_f32(sum), vget_high_f32(sum)));
+    return vget_lane_f32(vpadd_f32(folded, folded), 0);
+}
+
+double neon_dot(const unsigned char *a, const unsigned char *b, std::size_t count) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    float32x4_t sum(vdupq_n_f32(0.0f));
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4)
+        sum = vmlaq_f32(sum, vld1q_f32(x + i), vld1q_f32(y + i));
+    float total(horizontal_sum(sum));
+    return total + scalar_dot(a + i * sizeof(float), b + i * sizeof(float), count - i);
+}
+
+double neon_squared_distance(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    float32x4_t sum(vdupq_n_f32(0.0f));
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t difference(vsubq_f32(vld1q_f32(x + i), vld1q_f32(y + i)));
+        sum = vmlaq_f32(sum, difference, difference);
+    }
+    float total(horizontal_sum(sum));
+    return total + scalar_squared_distance(
+        a + i * sizeof(float), b + i * sizeof(float), count - i
+    );
+}
+
+cosine_terms neon_cosine(
+        const unsigned char *a,
+        const unsigned char *b,
+        std::size_t count
+) {
+    auto x(reinterpret_cast<const float *>(a)), y(reinterpret_cast<const float *>(b));
+    float32x4_t ab(vdupq_n_f32(0.0f)), aa(vdupq_n_f32(0.0f)), bb(vdupq_n_f32(0.0f));
+    std::size_t i(0);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t first(vld1q_f32(x + i)), second(vld1q_f32(y + i));
+        ab = vmlaq_f32(ab, first, second);
+        aa = vmlaq_f32(aa, first, first);
+        bb = vmlaq_f32(bb, second, second);
+    }
+    auto terms(scalar_cosine(a + i * sizeof(float), b + i * sizeof(float), count - i));
+    terms.ab += horizontal_sum(ab);
+    terms.aa += horizontal_sum(aa);
+    terms.bb += horizontal_sum(bb);
+    return terms;
+}
+
+#endif // __ARM_NEON
+
+kernel_set select_kernels() {
+#if defined(SQLITE_VECTOR_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return kernel_set{"avx2", &avx2_dot, &avx2_squared_distance, &avx2_cosine};
+#endif
+#if defined(__SSE2__)
+    return kernel_set{"sse2", &sse2_dot, &sse2_squared_distance, &sse2_cosine};
+#elif defined(__ARM_NEON)
+    return kernel_set{"neon", &neon_dot, &neon_squared_distance, &neon_cosine};
+#else
+    return kernel_set{"scalar", &scalar_dot, &scalar_squared_distance, &scalar_cosine};
+#endif
+}
+
+const kernel_set& kernels() {
+    static const kernel_set selected(select_kernels());
+    return selected;
+}
+
+// Reads both vector arguments, reporting a null result or an error itself
+// and returning false when the kernel should not run
+bool vector_arguments(
+        sqlite3_context *context,
+        sqlite3_value **argv,
+        const unsigned char *&a,
+        const unsigned char *&b,
+        std::size_t &count
+) {
+    int first(sqlite3_value_type(argv[0])), second(sqlite3_value_type(argv[1]));
+    if (first == SQLITE_NULL || second == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return false;
+    }
+    if (first != SQLITE_BLOB || second != SQLITE_BLOB) {
+        sqlite3_result_error(context, "vector arguments must be blobs", -1);
+        return false;
+    }
+    a = static_cast<const unsigned char *>(sqlite3_value_blob(argv[0]));
+    b = static_cast<const unsigned char *>(sqlite3_value_blob(argv[1]));
+    int size(sqlite3_value_bytes(argv[0]));
+    if (size != sqlite3_value_bytes(argv[1])) {
+        sqlite3_result_error(context, "vectors have different dimensions", -1);
+        return false;
+    }
+    if (size % sizeof(float)) {
+        sqlite3_result_error(context, "vector blob is not a whole number of floats", -1);
+        return false;
+    }
+    count = size / sizeof(float);
+    return true;
+}
+
+void vec_dot(sqlite3_context *context, int, sqlite3_value **argv) {
+    const unsigned char *a, *b;
+    std::size_t count;
+    if (vector_arguments(context, argv, a, b, count))
+        sqlite3_result_double(context, kernels().dot(a, b, count));
+}
+
+void vec_l2(sqlite3_context *context, int, sqlite3_value **argv) {
+    const unsigned char *a, *b;
+    std::size_t count;
+    if (vector_arguments(context, argv, a, b, count))
+        sqlite3_result_double(context, std::sqrt(kernels().squared_distance(a, b, count)));
+}
+
+// Cosine distance, so that smaller means closer for vec_l2 and vec_cosine
+// alike, null when either vector has no direction
+void vec_cosine(sqlite3_context *context, int, sqlite3_value **argv) {
+    const unsigned char *a, *b;
+    std::size_t count;
+    if (! vector_arguments(context, argv, a, b, count))
+        return;
+    auto terms(kernels().cosine(a, b, count));
+    if (terms.aa == 0.0 || terms.bb == 0.0) {
+        sqlite3_result_null(context);
+        return;
+    }
+    sqlite3_result_double(context, 1.0 - terms.ab / std::sqrt(terms.aa * terms.bb));
+}
+
+struct candidate {
+    double score;
+    uint64_t sequence;
+    int64_t id;
+
+    bool operator<(const candidate &other) const {
+        return score < other.score ||
+            (score == other.score && sequence < other.sequence);
+    }
+};
+
+struct top_k_state {
+    std::size_t k;
+    uint64_t sequence = 0;
+    std::vector<candidate> heap;
+};
+
+// vec_top_k(k, id, score) keeps the k ids with the lowest scores in a
+// bounded max-heap, earlier rows winning ties
+void vec_top_k_step(sqlite3_context *context, int, sqlite3_value **argv) {
+    auto state(static_cast<top_k_state **>(
+        sqlite3_aggregate_context(context, sizeof(top_k_state *))
+    ));
+    if (! state) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    try {
+        if (! *state) {
+            sqlite3_int64 k(sqlite3_value_int64(argv[0]));
+            if (sqlite3_value_type(argv[0]) != SQLITE_INTEGER || k <= 0) {
+                sqlite3_result_error(context, "vec_top_k requires a positive k", -1);
+                return;
+            }
+            *state = new top_k_state();
+            (*state)->k = k;
+            (*state)->heap.reserve(std::min<sqlite3_int64>(k, 4096));
+        }
+        if (sqlite3_value_type(argv[2]) == SQLITE_NULL)
+            return;
+        candidate row{
+            sqlite3_value_double(argv[2]),
+            (*state)->sequence++,
+            sqlite3_value_int64(argv[1])
+        };
+        auto &heap((*state)->heap);
+        if (heap.size() < (*state)->k) {
+            heap.push_back(row);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (row < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = row;
+            std::push_heap(heap.begin(), heap.end());
+        }
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void vec_top_k_final(sqlite3_context *context) {
+    auto state(static_cast<top_k_state **>(sqlite3_aggregate_context(context, 0)));
+    if (! state || ! *state) {
+        sqlite3_result_text(context, "[]", -1, SQLITE_STATIC);
+        return;
+    }
+    try {
+        auto &heap((*state)->heap);
+        std::sort_heap(heap.begin(), heap.end());
+        std::string ids("[");
+        for (const candidate &row : heap) {
+            if (ids.size() > 1)
+                ids += ',';
+            ids += std::to_string(row.id);
+        }
+        ids += ']';
+        sqlite3_result_text(context, ids.c_str(), ids.size(), SQLITE_TRANSIENT);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+    delete *state;
+    *state = nullptr;
+}
+
+} // namespace
+
+value pack_vector(const std::vector<float> &elements) {
+    return value(
+        value_type::blob,
+        elements.data(),
+        elements.size() * sizeof(float)
+    );
+}
+
+std::vector<float> unpack_vector(const value &packed) {
+    if (packed.type() != value_type::blob || packed.size() % sizeof(float))
+        throw error("value is not a packed float vector");
+    std::vector<float> elements(packed.size() / sizeof(float));
+    std::memcpy(elements.data(), packed.data(), packed.size());
+    return elements;
+}
+
+const char* vector_instruction_set() {
+    return kernels().name;
+}
+
+namespace detail {
+
+void register_vector_functions(sqlite3 *db) {
+    int flags(SQLITE_UTF8 | SQLITE_DETERMINISTIC);
+#ifdef SQLITE_INNOCUOUS
+    flags |= SQLITE_INNOCUOUS;
+#endif
+    struct scalar_function {
+        const char *name;
+        void (*function)(sqlite3_context *, int, sqlite3_value **);
+    };
+    const scalar_function functions[] = {
+        {"vec_dot", &vec_dot},
+        {"vec_l2", &vec_l2},
+        {"vec_cosine", &vec_cosine}
+    };
+    for (const scalar_function &function : functions) {
+        int status(sqlite3_create_function_v2(
+            db, function.name, 2, flags, nullptr,
+            function.function, nullptr, nullptr, nullptr
+        ));
+        if (status != SQLITE_OK)
+            throw error(status, std::string("while registering ") + function.name);
+    }
+    int status(sqlite3_create_function_v2(
+        db, "vec_top_k", 3, flags, nullptr,
+        nullptr, &vec_top_k_step, &vec_top_k_final, nullptr
+    ));
+    if (status != SQLITE_OK)
+        throw error(status, "while registering vec_top_k");
+}
+
+} // namespace detail
+
+} // namespace sqlite
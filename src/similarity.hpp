@@ -0,0 +1,45 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_SIMILARITY_H
+#define SQLITE_SIMILARITY_H
+
+#include "value.hpp"
+
+#include <vector>
+
+struct sqlite3;
+
+namespace sqlite {
+
+// Vectors are stored as blobs of packed native-endian float32 elements
+value pack_vector(const std::vector<float> &elements);
+std::vector<float> unpack_vector(const value &packed);
+
+// The kernel the vector functions dispatch to: "avx2", "sse2", "neon" or
+// "scalar"
+const char* vector_instruction_set();
+
+namespace detail {
+
+void register_vector_functions(sqlite3 *db);
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_SIMILARITY_H
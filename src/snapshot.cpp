@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "snapshot.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cassert>
+
+namespace sqlite {
+
+namespace {
+
+void end_transaction(sqlite3 *db) noexcept {
+    // Can't throw, called from destructors
+    (void) sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+#ifndef SQLITE_ENABLE_SNAPSHOT
+[[noreturn]] void throw_unsupported() {
+    throw error(
+        SQLITE_ERROR, "sqlite was built without SQLITE_ENABLE_SNAPSHOT"
+    );
+}
+#endif
+
+}   // namespace
+
+bool snapshot::supported() {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    return true;
+#else
+    return false;
+#endif
+}
+
+snapshot::snapshot(database &source, const std::string &schema):
+    schema_name(schema) {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    // A snapshot can only be taken inside a read transaction, which stays
+    // open so the wal can't be reset past the snapshot while it is in use.
+    // It runs on a connection of its own, ending one on the source would
+    // commit whatever the caller started there in the meantime.
+    const char *file(sqlite3_db_filename(source.db, schema.c_str()));
+    if (! file || ! *file)
+        throw error(SQLITE_ERROR, "schema " + schema + " has no database file to snapshot");
+    pinned.reset(new database(file, read_only));
+    (void) pinned->execute("BEGIN;");
+    sqlite3_snapshot *taken(nullptr);
+    auto status(SQLITE_OK);
+    try {
+        (void) pinned->execute_scalar<int>("PRAGMA main.schema_version;");
+        status = sqlite3_snapshot_get(pinned->db, "main", &taken);
+    } catch (...) {
+        end_transaction(pinned->db);
+        throw;
+    }
+    if (status != SQLITE_OK) {
+        end_transaction(pinned->db);
+        throw error(status, "while taking a snapshot of schema " + schema);
+    }
+    handle.reset(taken, &sqlite3_snapshot_free);
+#else
+    (void) source;
+    throw_unsupported();
+#endif
+}
+
+snapshot::snapshot(snapshot &&other) noexcept:
+    pinned(std::move(other.pinned)),
+    schema_name(std::move(other.schema_name)),
+    handle(std::move(other.handle)) {
+}
+
+snapshot::~snapshot() {
+    if (pinned)
+        end_transaction(pinned->db);
+}
+
+snapshot_transaction::snapshot_transaction(
+        database &reader,
+        const snapshot &state
+):
+    reader(reader) {
+    assert(state.handle && "snapshot_transaction opened on a moved from snapshot");
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    // Any read lets the connection discover that the database is in wal mode
+    (void) reader.execute_scalar<int>(
+        "PRAGMA " + detail::quote_identifier(state.schema()) + ".application_id;"
+    );
+    (void) reader.execute("BEGIN;");
+    auto status(sqlite3_snapshot_open(
+        reader.db, state.schema().c_str(), state.handle.get()
+    ));
+    if (status != SQLITE_OK) {
+        end_transaction(reader.db);
+        throw error(status, "while opening a snapshot of schema " + state.schema());
+    }
+#else
+    throw_unsupported();
+#endif
+}
+
+snapshot_transaction::~snapshot_transaction() {
+    end_transaction(reader.db);
+}
+
+} // namespace sqlite
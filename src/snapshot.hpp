@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_SNAPSHOT_H
+#define SQLITE_SNAPSHOT_H
+
+#include "database.hpp"
+
+#include <memory>
+#include <string>
+
+struct sqlite3_snapshot;
+
+namespace sqlite {
+
+class snapshot {
+public:
+    explicit snapshot(database &source, const std::string &schema = "main");
+    snapshot(const snapshot &other) = delete;
+    snapshot(snapshot &&other) noexcept;
+    ~snapshot();
+
+    snapshot& operator=(const snapshot &other) = delete;
+
+    static bool supported();
+
+    const std::string& schema() const { return schema_name; }
+
+private:
+    friend class snapshot_transaction;
+
+    std::unique_ptr<database> pinned;
+    std::string schema_name;
+    std::shared_ptr<sqlite3_snapshot> handle;
+};
+
+class snapshot_transaction {
+public:
+    snapshot_transaction(database &reader, const snapshot &state);
+    snapshot_transaction(const snapshot_transaction &other) = delete;
+    ~snapshot_transaction();
+
+    snapshot_transaction& operator=(const snapshot_transaction &other) = delete;
+
+private:
+    database &reader;
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_SNAPSHOT_H
@@ -16,32 +16,135 @@
 
 #include "statement.hpp"
 #include "error.hpp"
+#include "value.hpp"
+#include "affinity.hpp"
 
 #include <sqlite3.h>
 
+#include <mutex>
 #include <ostream>
 #include <cassert>
+#include <algorithm>
+#include <unordered_map>
 
 namespace sqlite {
 
 namespace {
 
+void reset_for_binding(const std::shared_ptr<sqlite3_stmt> &stmt) {
+    assert(stmt && "bind() called on null sqlite::statement");
+    detail::check_affinity(sqlite3_db_handle(stmt.get()));
+    sqlite3_reset(stmt.get());
+}
+
 std::size_t find_parameter_index(
         const std::string &parameter,
         const std::shared_ptr<sqlite3_stmt> &stmt
 ) {
-    assert(stmt && "bind() called on null sqlite::statement");
-    sqlite3_reset(stmt.get());
+    reset_for_binding(stmt);
     auto index(sqlite3_bind_parameter_index(stmt.get(), parameter.c_str()));
     if (! index)
         throw error(stmt, "while binding parameter '" + parameter + "'");
     return index;
 }
 
+int bind_value(sqlite3_stmt *stmt, const int index, const double &value) {
+    return sqlite3_bind_double(stmt, index, value);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const int &value) {
+    return sqlite3_bind_int(stmt, index, value);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const int64_t &value) {
+    return sqlite3_bind_int64(stmt, index, value);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const std::size_t &value) {
+    return sqlite3_bind_int64(stmt, index, value);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const bool &value) {
+    return sqlite3_bind_int(stmt, index, static_cast<int>(value));
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const null_t &) {
+    return sqlite3_bind_null(stmt, index);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const std::string &value) {
+    return sqlite3_bind_text(
+        stmt, index, value.c_str(), value.size(), SQLITE_STATIC
+    );
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const char *value) {
+    return sqlite3_bind_text(stmt, index, value, -1, SQLITE_STATIC);
+}
+
+int bind_value(sqlite3_stmt *stmt, const int index, const value &value) {
+    switch (value.type()) {
+    case value_type::integer:
+        return sqlite3_bind_int64(stmt, index, value.as<int64_t>());
+    case value_type::real:
+        return sqlite3_bind_double(stmt, index, value.as<double>());
+    case value_type::text:
+        return sqlite3_bind_text(
+            stmt, index, value.data(), value.size(), SQLITE_STATIC
+        );
+    case value_type::blob:
+        return sqlite3_bind_blob(
+            stmt, index, value.data(), value.size(), SQLITE_STATIC
+        );
+    default:
+        return sqlite3_bind_null(stmt, index);
+    }
+}
+
+value captured(const double &real) { return value(real); }
+value captured(const int &integer) { return value(int64_t(integer)); }
+value captured(const int64_t &integer) { return value(integer); }
+value captured(const std::size_t &integer) { return value(int64_t(integer)); }
+value captured(const bool &flag) { return value(int64_t(flag)); }
+value captured(const null_t &) { return value(); }
+value captured(const std::string &text) { return value(text); }
+value captured(const char *text) { return value(std::string(text)); }
+value captured(const value &bound) { return bound; }
+
+template<typename T>
+int bind_parameter(sqlite3_stmt *stmt, const int index, const T &value) {
+    auto status(bind_value(stmt, index, value));
+    if (status != SQLITE_OK)
+        return status;
+    // Only connections being captured pay for a copy of the value
+    auto capture(detail::capturing_bindings(stmt));
+    if (capture)
+        detail::note_binding(*capture, stmt, index, captured(value));
+    return status;
+}
+
+struct captured_statement {
+    bool complete;
+    std::vector<value> values;
+    std::vector<bool> bound;
+};
+
+const std::size_t capture_slots(64);
+
+expected<void> bind_outcome(
+        const int status,
+        const std::shared_ptr<sqlite3_stmt> &stmt,
+        const std::size_t &index
+) {
+    if (status != SQLITE_OK)
+        return error_code(status, stmt, index);
+    return {};
+}
+
 }
 
 statement::statement(const std::shared_ptr<sqlite3_stmt> &statement):
-        stmt(statement) {
+        stmt(statement), indices(std::make_shared<index_cache>()) {
     assert(statement && "attempt to create statement with null sqlite3_stmt");
 }
 
@@ -50,85 +153,150 @@ void statement::bind<blob>(const std::string &parameter, const blob &value) {
     assert(false && "blob support not implemented");
 }
 
-template<>
-void statement::bind<double>(
-        const std::string &parameter,
-        const double &value
-) {
+template<typename T>
+void statement::bind(const std::string &parameter, const T &value) {
     auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(
-        sqlite3_bind_double(stmt.get(), index, value),
-        parameter
-    );
+    throw_on_bind_error(bind_parameter(stmt.get(), index, value), parameter);
 }
 
-template<>
-void statement::bind<int>(const std::string &parameter, const int &value) {
+template void statement::bind<double>(const std::string &, const double &);
+template void statement::bind<int>(const std::string &, const int &);
+template void statement::bind<int64_t>(const std::string &, const int64_t &);
+template void statement::bind<std::size_t>(
+        const std::string &, const std::size_t &
+);
+template void statement::bind<bool>(const std::string &, const bool &);
+template void statement::bind<null_t>(const std::string &, const null_t &);
+template void statement::bind<std::string>(
+        const std::string &, const std::string &
+);
+template void statement::bind<value>(const std::string &, const value &);
+
+void statement::bind(const std::string &parameter, const char * value) {
     auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(sqlite3_bind_int(stmt.get(), index, value), parameter);
+    throw_on_bind_error(bind_parameter(stmt.get(), index, value), parameter);
 }
 
-template<>
-void statement::bind<int64_t>(
-        const std::string &parameter,
-        const int64_t &value
-) {
-    auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(
-        sqlite3_bind_int64(stmt.get(), index, value),
-        parameter
-    );
+template<typename T>
+void statement::bind(const std::size_t &index, const T &value) {
+    reset_for_binding(stmt);
+    throw_on_bind_error(bind_parameter(stmt.get(), index, value), index);
 }
 
-template<>
-void statement::bind<std::size_t>(
-        const std::string &parameter,
-        const std::size_t &value
-) {
-    auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(
-        sqlite3_bind_int64(stmt.get(), index, value),
-        parameter
-    );
+template void statement::bind<double>(const std::size_t &, const double &);
+template void statement::bind<int>(const std::size_t &, const int &);
+template void statement::bind<int64_t>(const std::size_t &, const int64_t &);
+template void statement::bind<std::size_t>(
+        const std::size_t &, const std::size_t &
+);
+template void statement::bind<bool>(const std::size_t &, const bool &);
+template void statement::bind<null_t>(const std::size_t &, const null_t &);
+template void statement::bind<std::string>(
+        const std::size_t &, const std::string &
+);
+template void statement::bind<value>(const std::size_t &, const value &);
+
+void statement::bind(const std::size_t &index, const char *value) {
+    reset_for_binding(stmt);
+    throw_on_bind_error(bind_parameter(stmt.get(), index, value), index);
 }
 
-template<>
-void statement::bind<bool>(const std::string &parameter, const bool &value) {
-    auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(
-        sqlite3_bind_int(stmt.get(), index, static_cast<int>(value)),
-        parameter
+void statement::bind(
+        const std::size_t &index,
+        const char *value,
+        const std::size_t &size
+) {
+    reset_for_binding(stmt);
+    auto status(sqlite3_bind_text(
+        stmt.get(), index, value, size, SQLITE_STATIC
+    ));
+    auto capture(
+        status == SQLITE_OK ? detail::capturing_bindings(stmt.get()) : nullptr
     );
+    if (capture) {
+        detail::note_binding(
+            *capture, stmt.get(), index, sqlite::value(value_type::text, value, size)
+        );
+    }
+    throw_on_bind_error(status, index);
 }
 
-template<>
-void statement::bind<null_t>(
+template<typename T>
+expected<void> statement::try_bind(
         const std::string &parameter,
-        const null_t &value
+        const T &value
 ) {
-    (void) value;
-    auto index(find_parameter_index(parameter, stmt));
-    throw_on_bind_error(sqlite3_bind_null(stmt.get(), index), parameter);
+    reset_for_binding(stmt);
+    auto index(sqlite3_bind_parameter_index(stmt.get(), parameter.c_str()));
+    if (! index)
+        return error_code(SQLITE_RANGE, stmt);
+    return bind_outcome(bind_parameter(stmt.get(), index, value), stmt, index);
 }
 
-template<>
-void statement::bind<std::string>(
+template expected<void> statement::try_bind<double>(
+        const std::string &, const double &
+);
+template expected<void> statement::try_bind<int>(
+        const std::string &, const int &
+);
+template expected<void> statement::try_bind<int64_t>(
+        const std::string &, const int64_t &
+);
+template expected<void> statement::try_bind<std::size_t>(
+        const std::string &, const std::size_t &
+);
+template expected<void> statement::try_bind<bool>(
+        const std::string &, const bool &
+);
+template expected<void> statement::try_bind<null_t>(
+        const std::string &, const null_t &
+);
+template expected<void> statement::try_bind<std::string>(
+        const std::string &, const std::string &
+);
+
+expected<void> statement::try_bind(
         const std::string &parameter,
-        const std::string &value
+        const char *value
 ) {
-    auto index(find_parameter_index(parameter, stmt));
-    auto status(sqlite3_bind_text(
-        stmt.get(), index, value.c_str(), value.size(), SQLITE_STATIC
-    ));
-    throw_on_bind_error(status, parameter);
+    reset_for_binding(stmt);
+    auto index(sqlite3_bind_parameter_index(stmt.get(), parameter.c_str()));
+    if (! index)
+        return error_code(SQLITE_RANGE, stmt);
+    return bind_outcome(bind_parameter(stmt.get(), index, value), stmt, index);
 }
 
-void statement::bind(const std::string &parameter, const char * value) {
-    auto index(find_parameter_index(parameter, stmt));
-    auto status(sqlite3_bind_text(
-        stmt.get(), index, value, -1, SQLITE_STATIC
-    ));
-    throw_on_bind_error(status, parameter);
+template<typename T>
+expected<void> statement::try_bind(const std::size_t &index, const T &value) {
+    reset_for_binding(stmt);
+    return bind_outcome(bind_parameter(stmt.get(), index, value), stmt, index);
+}
+
+template expected<void> statement::try_bind<double>(
+        const std::size_t &, const double &
+);
+template expected<void> statement::try_bind<int>(
+        const std::size_t &, const int &
+);
+template expected<void> statement::try_bind<int64_t>(
+        const std::size_t &, const int64_t &
+);
+template expected<void> statement::try_bind<std::size_t>(
+        const std::size_t &, const std::size_t &
+);
+template expected<void> statement::try_bind<bool>(
+        const std::size_t &, const bool &
+);
+template expected<void> statement::try_bind<null_t>(
+        const std::size_t &, const null_t &
+);
+template expected<void> statement::try_bind<std::string>(
+        const std::size_t &, const std::string &
+);
+
+expected<void> statement::try_bind(const std::size_t &index, const char *value) {
+    reset_for_binding(stmt);
+    return bind_outcome(bind_parameter(stmt.get(), index, value), stmt, index);
 }
 
 void statement::clear_bindings() {
@@ -136,6 +304,9 @@ void statement::clear_bindings() {
     auto status(sqlite3_clear_bindings(stmt.get()));
     if (status != SQLITE_OK)
         throw error(status);
+    auto capture(detail::capturing_bindings(stmt.get()));
+    if (capture)
+        detail::note_cleared(*capture, stmt.get());
 }
 
 std::size_t statement::parameter_count() const {
@@ -151,15 +322,206 @@ void statement::throw_on_bind_error(
         throw error(stmt, "while binding parameter '" + parameter + "'");
 }
 
+void statement::throw_on_bind_error(
+        const int status,
+        const std::size_t &index
+) const {
+    if (status != SQLITE_OK)
+        throw error(stmt, "while binding parameter " + std::to_string(index));
+}
+
 std::ostream& operator<<(std::ostream &os, const statement &statement) {
     os << "statement:\n"
           "  sql: " << sqlite3_sql(statement.stmt.get()) << "\n";
     return os;
 }
 
+const std::vector<int>& statement::resolve_parameters(
+        const void *key,
+        const std::vector<const char *> &names
+) {
+    assert(stmt && "bind() called on null sqlite::statement");
+    static const char prefixes[] = {':', '@', '$'};
+    std::vector<int> parameters;
+    parameters.reserve(names.size());
+    for (const char *name : names) {
+        int index(0);
+        for (std::size_t i(0); ! index && i < sizeof(prefixes); ++i) {
+            std::string parameter(prefixes[i] + std::string(name));
+            index = sqlite3_bind_parameter_index(stmt.get(), parameter.c_str());
+        }
+        parameters.push_back(index);
+    }
+    return indices->insert(key, std::move(parameters));
+}
+
+namespace detail {
+
+// One per capturing connection, its statements are only locked by the
+// threads using that connection
+struct binding_capture {
+    std::atomic<sqlite3 *> db{nullptr};
+    std::size_t users = 0;
+    std::mutex mutex;
+    std::unordered_map<sqlite3_stmt *, captured_statement> statements;
+};
+
+} // namespace detail
+
+namespace {
+
+// Slots are reused but never freed, so lookups can compare connections
+// without a lock while captures start and stop on other threads
+struct capture_table {
+    std::mutex mutex;
+    std::atomic<std::size_t> used{0};
+    detail::binding_capture slots[capture_slots];
+};
+
+// Never destroyed, statements with static storage may be finalized after it
+capture_table& captures() {
+    static capture_table *instance(new capture_table());
+    return *instance;
+}
+
+void note_parameters(
+        detail::binding_capture &capture,
+        sqlite3_stmt *stmt,
+        const bool &known
+) {
+    // Parameters of a fresh statement are null until bound
+    std::size_t count(sqlite3_bind_parameter_count(stmt));
+    capture.statements[stmt] = captured_statement{
+        known, std::vector<value>(count), std::vector<bool>(count, known)
+    };
+}
+
+}
+
+namespace detail {
+
+std::atomic<int> binding_captures(0);
+
+binding_capture* capture_of(sqlite3_stmt *stmt) {
+    sqlite3 *db(sqlite3_db_handle(stmt));
+    auto &table(captures());
+    auto used(table.used.load(std::memory_order_acquire));
+    for (std::size_t i(0); i < used; ++i) {
+        if (table.slots[i].db.load(std::memory_order_acquire) == db)
+            return &table.slots[i];
+    }
+    return nullptr;
+}
+
+void capture_bindings(sqlite3 *db) {
+    auto &table(captures());
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto used(table.used.load(std::memory_order_relaxed));
+    binding_capture *unused(nullptr);
+    for (std::size_t i(0); i < used; ++i) {
+        auto &slot(table.slots[i]);
+        sqlite3 *owner(slot.db.load(std::memory_order_relaxed));
+        if (owner == db) {
+            ++slot.users;
+            return;
+        }
+        if (! owner && ! unused)
+            unused = &slot;
+    }
+    if (! unused) {
+        if (used == capture_slots)
+            throw error("too many connections capturing bound values");
+        unused = &table.slots[used];
+        table.used.store(used + 1, std::memory_order_release);
+    }
+    unused->users = 1;
+    unused->db.store(db, std::memory_order_release);
+    ++binding_captures;
+}
+
+void release_bindings(sqlite3 *db) {
+    auto &table(captures());
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto used(table.used.load(std::memory_order_relaxed));
+    for (std::size_t i(0); i < used; ++i) {
+        auto &slot(table.slots[i]);
+        if (slot.db.load(std::memory_order_relaxed) != db)
+            continue;
+        if (--slot.users > 0)
+            return;
+        {
+            std::lock_guard<std::mutex> statements_lock(slot.mutex);
+            slot.statements.clear();
+        }
+        slot.db.store(nullptr, std::memory_order_release);
+        --binding_captures;
+        return;
+    }
+}
+
+void note_prepared(binding_capture &capture, sqlite3_stmt *stmt) {
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    note_parameters(capture, stmt, true);
+}
+
+void note_binding(
+        binding_capture &capture,
+        sqlite3_stmt *stmt,
+        const int &index,
+        const value &bound
+) {
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    auto found(capture.statements.find(stmt));
+    if (found == capture.statements.end()) {
+        // Bound before capturing started, earlier parameters are unknown
+        note_parameters(capture, stmt, false);
+        found = capture.statements.find(stmt);
+    }
+    auto &captured(found->second);
+    captured.values[index - 1] = bound;
+    captured.bound[index - 1] = true;
+}
+
+void note_cleared(binding_capture &capture, sqlite3_stmt *stmt) {
+    note_prepared(capture, stmt);
+}
+
+bool bound_values(sqlite3_stmt *stmt, std::vector<value> &values) {
+    values.clear();
+    auto capture(capturing_bindings(stmt));
+    if (! capture)
+        return sqlite3_bind_parameter_count(stmt) == 0;
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    auto found(capture->statements.find(stmt));
+    if (found == capture->statements.end())
+        return sqlite3_bind_parameter_count(stmt) == 0;
+    auto &captured(found->second);
+    if (! captured.complete) {
+        captured.complete = std::all_of(
+            captured.bound.begin(), captured.bound.end(),
+            [](const bool &bound) { return bound; }
+        );
+    }
+    values = captured.values;
+    return captured.complete;
+}
+
+void finalize_statement(sqlite3_stmt *stmt) {
+    auto capture(stmt ? capturing_bindings(stmt) : nullptr);
+    if (capture) {
+        std::lock_guard<std::mutex> lock(capture->mutex);
+        capture->statements.erase(stmt);
+    }
+    (void) sqlite3_finalize(stmt);
+}
+
+} // namespace detail
+
 result make_result(const statement &statement) {
     (void) sqlite3_reset(statement.stmt.get());
-    return statement.stmt;
+    result results(statement.stmt);
+    results.column_indices = statement.indices;
+    return results;
 }
 
 } // namespace sqlite
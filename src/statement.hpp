@@ -18,7 +18,10 @@
 #define SQLITE_STATEMENT_H
 
 #include "result.hpp"
+#include "expected.hpp"
 
+#include <atomic>
+#include <vector>
 #include <cstddef>
 
 struct sqlite3;
@@ -27,8 +30,42 @@ struct sqlite3_stmt;
 namespace sqlite {
 
 class blob;
+class value;
 class statement;
 
+namespace detail {
+
+// Exact copies of the values bound on connections that asked for them.
+// sqlite only hands bound values back as expanded sql, which rounds reals.
+struct binding_capture;
+
+extern std::atomic<int> binding_captures;
+
+// Lock free, null unless the statement's own connection is capturing
+binding_capture* capture_of(sqlite3_stmt *stmt);
+
+inline binding_capture* capturing_bindings(sqlite3_stmt *stmt) {
+    if (binding_captures.load(std::memory_order_acquire) == 0)
+        return nullptr;
+    return capture_of(stmt);
+}
+
+void capture_bindings(sqlite3 *db);
+void release_bindings(sqlite3 *db);
+void note_prepared(binding_capture &capture, sqlite3_stmt *stmt);
+void note_binding(
+        binding_capture &capture,
+        sqlite3_stmt *stmt,
+        const int &index,
+        const value &bound
+);
+void note_cleared(binding_capture &capture, sqlite3_stmt *stmt);
+// False unless every parameter was bound while capturing
+bool bound_values(sqlite3_stmt *stmt, std::vector<value> &values);
+void finalize_statement(sqlite3_stmt *stmt);
+
+} // namespace detail
+
 enum class null_t {
     null
 };
@@ -48,6 +85,22 @@ public:
     template<typename T>
     void bind(const std::string &parameter, const T &value);
     void bind(const std::string &parameter, const char *value);
+    template<typename T>
+    void bind(const std::size_t &index, const T &value);
+    void bind(const std::size_t &index, const char *value);
+    void bind(
+            const std::size_t &index,
+            const char *value,
+            const std::size_t &size
+    );
+    template<typename T>
+    void bind(const T &object);
+    template<typename T>
+    expected<void> try_bind(const std::string &parameter, const T &value);
+    expected<void> try_bind(const std::string &parameter, const char *value);
+    template<typename T>
+    expected<void> try_bind(const std::size_t &index, const T &value);
+    expected<void> try_bind(const std::size_t &index, const char *value);
     void clear_bindings();
 
     friend std::ostream& operator<<(
@@ -59,10 +112,23 @@ private:
             const int status,
             const std::string &parameter
     ) const;
+    void throw_on_bind_error(
+            const int status,
+            const std::size_t &index
+    ) const;
+    const std::vector<int>& resolve_parameters(
+            const void *key,
+            const std::vector<const char *> &names
+    );
     friend result make_result(const statement &statement);
+    friend class database;
+    friend class result_cache;
+    friend class paged_cursor;
+    friend class column_codec;
 
 private:
     std::shared_ptr<sqlite3_stmt> stmt;
+    std::shared_ptr<index_cache> indices;
 };
 
 } // namespace sqlite
@@ -0,0 +1,236 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_STATIC_STATEMENT_H
+#define SQLITE_STATIC_STATEMENT_H
+
+#if __cplusplus < 202002L
+#error "sqlite::static_statement requires a C++20 compiler"
+#endif
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "result.hpp"
+#include "row.hpp"
+
+#include <array>
+#include <tuple>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+namespace sqlite {
+
+template<std::size_t N>
+struct fixed_string {
+    constexpr fixed_string(const char (&text)[N]) {
+        std::copy_n(text, N, value);
+    }
+
+    constexpr std::size_t size() const { return N - 1; }
+    constexpr char operator[](const std::size_t &i) const { return value[i]; }
+
+    char value[N] = {};
+};
+
+template<typename... Types> struct parameters {};
+template<typename... Types> struct columns {};
+
+namespace detail {
+
+struct static_statement_access {
+    static statement& prepare(
+            database &db,
+            const std::size_t &slot,
+            const char *sql
+    ) {
+        return db.slot_statement(slot, sql);
+    }
+};
+
+constexpr bool is_identifier_char(const char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9') || c == '_' || c == '$'
+        || static_cast<unsigned char>(c) >= 0x80;
+}
+
+struct parameter_name {
+    std::size_t offset = 0;
+    std::size_t length = 0;
+    std::size_t index = 0;
+};
+
+template<std::size_t N>
+struct parameter_table {
+    std::size_t count = 0;
+    std::size_t name_count = 0;
+    std::array<parameter_name, N> names = {};
+};
+
+// Numbers parameters the way sqlite3_prepare does: ?NNN takes index NNN,
+// a bare ? takes the next index and a repeated :name, @name or $name
+// reuses the index of its first occurrence.
+template<fixed_string Sql>
+constexpr parameter_table<Sql.size() + 1> parse_parameters() {
+    parameter_table<Sql.size() + 1> table;
+    const std::size_t size(Sql.size());
+    std::size_t i(0);
+    while (i < size) {
+        const char c(Sql[i]);
+        if (c == '\'' || c == '"' || c == '`' || c == '[') {
+            const char close(c == '[' ? ']' : c);
+            for (++i; i < size; ++i) {
+                if (Sql[i] == close) {
+                    if (close != ']' && i + 1 < size && Sql[i + 1] == close)
+                        ++i;
+                    else
+                        break;
+                }
+            }
+            ++i;
+        } else if (c == '-' && i + 1 < size && Sql[i + 1] == '-') {
+            while (i < size && Sql[i] != '\n')
+                ++i;
+        } else if (c == '/' && i + 1 < size && Sql[i + 1] == '*') {
+            i += 2;
+            while (i < size && ! (Sql[i] == '*' && i + 1 < size && Sql[i + 1] == '/'))
+                ++i;
+            i += 2;
+        } else if (c == '?') {
+            std::size_t number(0);
+            bool numbered(false);
+            for (++i; i < size && Sql[i] >= '0' && Sql[i] <= '9'; ++i) {
+                number = number * 10 + (Sql[i] - '0');
+                numbered = true;
+            }
+            if (numbered && number == 0)
+                throw "parameter ?0 is out of range";
+            table.count = numbered ? std::max(table.count, number) : table.count + 1;
+        } else if ((c == ':' || c == '@' || c == '$')
+                && i + 1 < size && is_identifier_char(Sql[i + 1])) {
+            parameter_name name;
+            name.offset = i;
+            for (++i; i < size && is_identifier_char(Sql[i]); ++i) {}
+            name.length = i - name.offset;
+            for (std::size_t n(0); n < table.name_count && ! name.index; ++n) {
+                const parameter_name &seen(table.names[n]);
+                bool same(seen.length == name.length);
+                for (std::size_t k(0); same && k < name.length; ++k)
+                    same = Sql[seen.offset + k] == Sql[name.offset + k];
+                if (same)
+                    name.index = seen.index;
+            }
+            if (! name.index) {
+                name.index = ++table.count;
+                table.names[table.name_count++] = name;
+            }
+        } else if (is_identifier_char(c)) {
+            while (i < size && is_identifier_char(Sql[i]))
+                ++i;
+        } else {
+            ++i;
+        }
+    }
+    return table;
+}
+
+template<fixed_string Sql, fixed_string Name>
+constexpr std::size_t find_parameter() {
+    constexpr auto table(parse_parameters<Sql>());
+    for (std::size_t n(0); n < table.name_count; ++n) {
+        const parameter_name &name(table.names[n]);
+        bool same(name.length == Name.size());
+        for (std::size_t k(0); same && k < name.length; ++k)
+            same = Sql[name.offset + k] == Name[k];
+        if (same)
+            return name.index;
+    }
+    if (Name.size() > 1 && Name[0] == '?') {
+        std::size_t number(0);
+        for (std::size_t k(1); k < Name.size(); ++k) {
+            if (Name[k] < '0' || Name[k] > '9')
+                return 0;
+            number = number * 10 + (Name[k] - '0');
+        }
+        return number <= table.count ? number : 0;
+    }
+    return 0;
+}
+
+} // namespace detail
+
+template<
+    fixed_string Sql,
+    typename Parameters = parameters<>,
+    typename Columns = columns<>
+>
+class static_statement;
+
+template<fixed_string Sql, typename... Parameters, typename... Columns>
+class static_statement<Sql, parameters<Parameters...>, columns<Columns...>> {
+public:
+    using row_type = std::tuple<Columns...>;
+
+    static constexpr std::size_t parameter_count =
+        detail::parse_parameters<Sql>().count;
+    static_assert(
+        sizeof...(Parameters) == parameter_count,
+        "declared parameter types do not match the placeholders in the sql"
+    );
+
+    template<fixed_string Name>
+    static constexpr std::size_t parameter_index() {
+        constexpr std::size_t index(detail::find_parameter<Sql, Name>());
+        static_assert(index != 0, "no such parameter in the sql statement");
+        return index;
+    }
+
+    static statement& prepare(database &db) {
+        return detail::static_statement_access::prepare(db, slot, Sql.value);
+    }
+
+    static result execute(database &db, const Parameters &... values) {
+        statement &stmt(prepare(db));
+        bind_all(stmt, std::index_sequence_for<Parameters...>(), values...);
+        return db.execute(stmt);
+    }
+
+    static row_type decode(const row &row) {
+        return decode(row, std::index_sequence_for<Columns...>());
+    }
+
+private:
+    template<std::size_t... Index>
+    static void bind_all(
+            statement &stmt,
+            std::index_sequence<Index...>,
+            const Parameters &... values
+    ) {
+        (stmt.bind(std::size_t(Index + 1), values), ...);
+    }
+
+    template<std::size_t... Index>
+    static row_type decode(const row &row, std::index_sequence<Index...>) {
+        return row_type(row[std::size_t(Index)].template as<Columns>()...);
+    }
+
+private:
+    static inline const std::size_t slot = detail::next_statement_slot();
+};
+
+} // namespace sqlite
+
+#endif // SQLITE_STATIC_STATEMENT_H
@@ -0,0 +1,169 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "bloom.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace {
+
+sqlite::value key(const int64_t &number) {
+    return sqlite::value(number);
+}
+
+} // namespace
+
+TEST(bloom_filter, never_forgets_a_key_and_rarely_invents_one) {
+    sqlite::bloom_filter filter(10000, 0.01);
+    for (int64_t i(0); i < 10000; ++i)
+        filter.insert(key(i * 2));
+    std::size_t false_positives(0);
+    for (int64_t i(0); i < 10000; ++i) {
+        EXPECT_TRUE(filter.may_contain(key(i * 2)));
+        false_positives += filter.may_contain(key(i * 2 + 1));
+    }
+    EXPECT_LT(false_positives, 300u);
+}
+
+TEST(bloom_filter, hashes_keys_the_way_sqlite_compares_them) {
+    sqlite::bloom_filter filter(100);
+    filter.insert(key(3));
+    filter.insert(sqlite::value(std::string("name")));
+    EXPECT_TRUE(filter.may_contain(sqlite::value(3.0)));
+    EXPECT_EQ(
+        sqlite::bloom_filter::hash(key(3)),
+        sqlite::bloom_filter::hash(sqlite::value(3.0))
+    );
+    EXPECT_NE(
+        sqlite::bloom_filter::hash(sqlite::value(std::string("name"))),
+        sqlite::bloom_filter::hash(sqlite::value(sqlite::value_type::blob, "name", 4))
+    );
+    EXPECT_FALSE(filter.may_contain(sqlite::value()));
+}
+
+class existence: public testing::Test {
+protected:
+    void SetUp() {
+        path = testing::TempDir() + "xxsqlite_bloom_test.db";
+        std::remove(path.c_str());
+        db = std::make_unique<sqlite::database>(path, sqlite::read_write_create);
+        (void) db->execute_script(
+            "CREATE TABLE accounts (id INTEGER PRIMARY KEY, email TEXT UNIQUE);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n"
+            " WHERE i < 5000) INSERT INTO accounts (email)"
+            " SELECT 'user' || i || '@example.com' FROM n;"
+        );
+    }
+
+    void TearDown() {
+        db.reset();
+        std::remove(path.c_str());
+    }
+
+    bool may_contain(const std::string &email) {
+        return db->may_contain("accounts", sqlite::value(email));
+    }
+
+    std::string path;
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(existence, answers_from_a_scan_of_the_table) {
+    db->track_existence("accounts", "email");
+    std::size_t false_positives(0);
+    for (int i(1); i <= 5000; ++i) {
+        EXPECT_TRUE(may_contain("user" + std::to_string(i) + "@example.com"));
+        false_positives += may_contain("other" + std::to_string(i) + "@example.com");
+    }
+    EXPECT_LT(false_positives, 150u);
+}
+
+TEST_F(existence, sees_uncommitted_inserts_and_updates) {
+    db->track_existence("accounts", "email");
+    sqlite::as_transaction(*db, [this](sqlite::database &db) {
+        (void) db.execute("INSERT INTO accounts (email) VALUES ('new@example.com');");
+        EXPECT_TRUE(may_contain("new@example.com"));
+        (void) db.execute(
+            "UPDATE accounts SET email = 'renamed@example.com' WHERE id = 1;"
+        );
+        EXPECT_TRUE(may_contain("renamed@example.com"));
+    });
+}
+
+TEST_F(existence, never_forgets_rows_restored_by_a_rollback) {
+    db->track_existence("accounts", "email");
+    (void) db->execute("BEGIN;");
+    (void) db->execute("DELETE FROM accounts WHERE id > 0;");
+    EXPECT_TRUE(may_contain("user5@example.com"));
+    db->track_existence("accounts", "email");
+    EXPECT_TRUE(may_contain("user6@example.com"));
+    (void) db->execute("ROLLBACK;");
+    for (int i(1); i <= 5000; ++i)
+        EXPECT_TRUE(may_contain("user" + std::to_string(i) + "@example.com"));
+}
+
+TEST_F(existence, rebuilds_after_writes_from_other_connections) {
+    sqlite::existence_options options;
+    options.external_check_interval = std::chrono::milliseconds(0);
+    db->track_existence("accounts", "email", options);
+    sqlite::database other(path, sqlite::read_write);
+    (void) other.execute("INSERT INTO accounts (email) VALUES ('elsewhere@example.com');");
+    EXPECT_TRUE(may_contain("elsewhere@example.com"));
+}
+
+TEST_F(existence, checks_for_writes_from_other_connections_once_per_interval) {
+    sqlite::existence_options options;
+    options.external_check_interval = std::chrono::milliseconds(50);
+    db->track_existence("accounts", "email", options);
+    sqlite::database other(path, sqlite::read_write);
+    (void) other.execute("INSERT INTO accounts (email) VALUES ('elsewhere@example.com');");
+    std::this_thread::sleep_for(options.external_check_interval);
+    EXPECT_TRUE(may_contain("elsewhere@example.com"));
+}
+
+TEST_F(existence, rebuilds_once_deletes_or_overflow_make_it_stale) {
+    sqlite::existence_options options;
+    options.track_external_writes = false;
+    options.change_capacity = 4;
+    db->track_existence("accounts", "email", options);
+    (void) db->execute("DELETE FROM accounts WHERE id > 0;");
+    std::size_t remembered(0);
+    for (int i(1); i <= 5000; ++i)
+        remembered += may_contain("user" + std::to_string(i) + "@example.com");
+    EXPECT_LT(remembered, 150u);
+
+    (void) db->execute_script(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n"
+        " WHERE i < 100) INSERT INTO accounts (email)"
+        " SELECT 'batch' || i || '@example.com' FROM n;"
+    );
+    for (int i(1); i <= 100; ++i)
+        EXPECT_TRUE(may_contain("batch" + std::to_string(i) + "@example.com"));
+}
+
+TEST_F(existence, requires_a_tracked_rowid_table) {
+    (void) db->execute("CREATE TABLE tags (name TEXT PRIMARY KEY) WITHOUT ROWID;");
+    EXPECT_THROW(db->track_existence("tags", "name"), sqlite::error);
+    EXPECT_DEBUG_DEATH(may_contain("user1@example.com"), "");
+}
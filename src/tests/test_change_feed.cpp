@@ -0,0 +1,128 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "change_feed.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class change_feed: public testing::Test {
+protected:
+    change_feed(): db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute("CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT);");
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(change_feed, publishes_autocommitted_changes) {
+    auto feed(db.subscribe_changes());
+    (void) db.execute("INSERT INTO test (id, name) VALUES (7, 'one');");
+    (void) db.execute("UPDATE test SET name = 'two' WHERE id = 7;");
+    (void) db.execute("DELETE FROM test WHERE id = 7;");
+    std::vector<sqlite::change> changes;
+    ASSERT_EQ(3u, feed.drain(changes));
+    EXPECT_EQ(sqlite::change_operation::insert, changes[0].operation);
+    EXPECT_EQ(sqlite::change_operation::update, changes[1].operation);
+    EXPECT_EQ(sqlite::change_operation::remove, changes[2].operation);
+    for (const sqlite::change &change : changes) {
+        EXPECT_EQ("main", change.database);
+        EXPECT_EQ("test", change.table);
+        EXPECT_EQ(7, change.rowid);
+    }
+}
+
+TEST_F(change_feed, publishes_a_transaction_only_when_it_commits) {
+    auto feed(db.subscribe_changes());
+    sqlite::change next;
+    sqlite::as_transaction(db, [&](sqlite::database &db) {
+        (void) db.execute("INSERT INTO test (name) VALUES ('one');");
+        (void) db.execute("INSERT INTO test (name) VALUES ('two');");
+        EXPECT_FALSE(feed.poll(next));
+    });
+    std::vector<sqlite::change> changes;
+    EXPECT_EQ(2u, feed.drain(changes));
+}
+
+TEST_F(change_feed, discards_changes_that_are_rolled_back) {
+    auto feed(db.subscribe_changes());
+    EXPECT_THROW(
+        sqlite::as_transaction(db, [](sqlite::database &db) {
+            (void) db.execute("INSERT INTO test (name) VALUES ('one');");
+            throw sqlite::error("abandon");
+        }), sqlite::error
+    );
+    (void) db.execute("INSERT INTO test (id, name) VALUES (3, 'three');");
+    std::vector<sqlite::change> changes;
+    ASSERT_EQ(1u, feed.drain(changes));
+    EXPECT_EQ(3, changes[0].rowid);
+}
+
+TEST_F(change_feed, delivers_every_change_to_each_subscriber) {
+    auto first(db.subscribe_changes());
+    auto second(db.subscribe_changes());
+    (void) db.execute("INSERT INTO test (name) VALUES ('one');");
+    std::vector<sqlite::change> changes;
+    EXPECT_EQ(1u, first.drain(changes));
+    EXPECT_EQ(1u, second.drain(changes));
+}
+
+TEST_F(change_feed, drops_transactions_that_overflow_a_slow_subscriber) {
+    auto feed(db.subscribe_changes(4));
+    (void) db.execute("INSERT INTO test (name) VALUES ('one');");
+    sqlite::as_transaction(db, [](sqlite::database &db) {
+        for (int i(0); i < 4; ++i)
+            (void) db.execute("INSERT INTO test (name) VALUES ('many');");
+    });
+    std::vector<sqlite::change> changes;
+    EXPECT_EQ(1u, feed.drain(changes));
+    EXPECT_EQ(4u, feed.dropped());
+}
+
+TEST_F(change_feed, can_be_consumed_on_another_thread) {
+    auto feed(db.subscribe_changes(1024));
+    std::atomic<bool> finished(false);
+    int64_t received(0);
+    std::thread consumer([&] {
+        sqlite::change next;
+        for (;;) {
+            if (feed.poll(next)) {
+                received += next.rowid;
+            } else if (finished) {
+                while (feed.poll(next))
+                    received += next.rowid;
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int64_t expected(0);
+    for (int i(1); i <= 1000; ++i) {
+        (void) db.execute("INSERT INTO test (name) VALUES ('row');");
+        expected += i;
+    }
+    finished = true;
+    consumer.join();
+    EXPECT_EQ(0u, feed.dropped());
+    EXPECT_EQ(expected, received);
+}
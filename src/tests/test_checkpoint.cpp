@@ -0,0 +1,142 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "checkpoint.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <functional>
+#include <mem/memory.hpp>
+
+class checkpoint: public testing::Test {
+protected:
+    void SetUp() {
+        path = testing::TempDir() + "xxsqlite_checkpoint_test.db";
+        remove_files();
+        db = std::make_unique<sqlite::database>(path, sqlite::read_write_create);
+        (void) db->execute("PRAGMA journal_mode = WAL;");
+        (void) db->execute("PRAGMA busy_timeout = 5000;");
+        (void) db->execute("CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT);");
+    }
+
+    void TearDown() {
+        db.reset();
+        remove_files();
+    }
+
+    void remove_files() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    void insert_rows(const int &count) {
+        for (int i(0); i < count; ++i)
+            (void) db->execute("INSERT INTO test (name) VALUES (hex(randomblob(200)));");
+    }
+
+    bool eventually(const std::function<bool()> &condition) {
+        for (int i(0); i < 200 && ! condition(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return condition();
+    }
+
+    std::string path;
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(checkpoint, disables_automatic_checkpoints_while_managed) {
+    {
+        sqlite::checkpoint_manager manager(*db);
+        EXPECT_EQ(0, db->execute_scalar<int>("PRAGMA wal_autocheckpoint;"));
+    }
+    EXPECT_EQ(1000, db->execute_scalar<int>("PRAGMA wal_autocheckpoint;"));
+}
+
+TEST_F(checkpoint, restores_the_automatic_checkpoint_threshold_it_replaced) {
+    (void) db->execute("PRAGMA wal_autocheckpoint = 250;");
+    {
+        sqlite::checkpoint_manager manager(*db);
+    }
+    EXPECT_EQ(250, db->execute_scalar<int>("PRAGMA wal_autocheckpoint;"));
+}
+
+TEST_F(checkpoint, checkpoints_in_the_background_once_the_wal_is_large_enough) {
+    sqlite::checkpoint_policy policy;
+    policy.frame_threshold = 10;
+    policy.idle_time = std::chrono::seconds(60);
+    sqlite::checkpoint_manager manager(*db, policy);
+    insert_rows(40);
+    EXPECT_TRUE(eventually([&] { return manager.statistics().passive > 0; }));
+    EXPECT_LT(0, manager.statistics().frames_checkpointed);
+}
+
+TEST_F(checkpoint, checkpoints_after_the_writer_has_been_idle) {
+    sqlite::checkpoint_policy policy;
+    policy.frame_threshold = 1000000;
+    policy.idle_time = std::chrono::milliseconds(20);
+    sqlite::checkpoint_manager manager(*db, policy);
+    insert_rows(1);
+    EXPECT_TRUE(eventually([&] { return manager.statistics().checkpoints() > 0; }));
+}
+
+TEST_F(checkpoint, escalates_to_truncate_for_a_large_wal) {
+    sqlite::checkpoint_policy policy;
+    policy.frame_threshold = 5;
+    policy.restart_threshold = 5;
+    policy.truncate_threshold = 5;
+    policy.idle_time = std::chrono::seconds(60);
+    sqlite::checkpoint_manager manager(*db, policy);
+    insert_rows(20);
+    EXPECT_TRUE(eventually([&] { return manager.statistics().truncate > 0; }));
+    EXPECT_EQ(0, manager.statistics().passive);
+}
+
+TEST_F(checkpoint, stays_responsive_after_truncating_the_wal) {
+    sqlite::checkpoint_policy policy;
+    policy.frame_threshold = 10;
+    policy.restart_threshold = 20;
+    policy.truncate_threshold = 30;
+    policy.idle_time = std::chrono::seconds(60);
+    auto manager(std::make_unique<sqlite::checkpoint_manager>(*db, policy));
+    sqlite::as_transaction(*db, [this](sqlite::database &) { insert_rows(400); });
+    EXPECT_TRUE(eventually([&] { return manager->statistics().truncate > 0; }));
+    auto checkpoints(manager->statistics().checkpoints());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(checkpoints, manager->statistics().checkpoints());
+    manager.reset();
+}
+
+TEST_F(checkpoint, checkpoints_on_request) {
+    sqlite::checkpoint_policy policy;
+    policy.frame_threshold = 1000000;
+    policy.idle_time = std::chrono::seconds(60);
+    sqlite::checkpoint_manager manager(*db, policy);
+    manager.request_checkpoint();
+    EXPECT_TRUE(eventually([&] { return manager.statistics().passive == 1; }));
+}
+
+TEST_F(checkpoint, throws_database_error_unless_the_database_uses_a_wal) {
+    sqlite::database memory(sqlite::in_memory, sqlite::read_write_create);
+    EXPECT_THROW(sqlite::checkpoint_manager manager(memory), sqlite::error);
+    (void) db->execute("PRAGMA journal_mode = DELETE;");
+    EXPECT_THROW(sqlite::checkpoint_manager manager(*db), sqlite::error);
+}
@@ -0,0 +1,205 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "codec.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string json_document(const int &id) {
+    std::string document("{\"id\":" + std::to_string(id) + ",\"tags\":[");
+    for (int i(0); i < 20; ++i)
+        document += "\"tag-" + std::to_string(i % 7) + "\",";
+    return document + "\"last\"],\"status\":\"active\"}";
+}
+
+std::string round_trip(const std::string &input) {
+    auto lz(sqlite::lz_codec());
+    std::string compressed, output;
+    lz->compress(input.data(), input.size(), compressed);
+    lz->decompress(compressed.data(), compressed.size(), input.size(), output);
+    return output;
+}
+
+class reversing_codec: public sqlite::codec {
+public:
+    const char* name() const override { return "reversed"; }
+    void compress(const char *data, const std::size_t &size, std::string &output) const override {
+        output.assign(data, size);
+        output.assign(output.rbegin(), output.rend());
+        output.pop_back();
+    }
+    void decompress(
+            const char *data,
+            const std::size_t &size,
+            const std::size_t &,
+            std::string &output
+    ) const override {
+        output.assign(data, size);
+        output.assign(output.rbegin(), output.rend());
+        output.insert(output.begin(), 'x');
+    }
+};
+
+} // namespace
+
+class codec: public testing::Test {
+protected:
+    codec(): db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute("CREATE TABLE documents (id INTEGER PRIMARY KEY, payload);");
+        db.register_codec(sqlite::lz_codec());
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(codec, lz_round_trips_assorted_inputs) {
+    std::mt19937 random(42);
+    std::string noise(5000, '\0');
+    for (char &c : noise)
+        c = static_cast<char>(random());
+    std::vector<std::string> inputs{
+        "", "a", "short text", std::string(100000, 'z'), noise,
+        json_document(1) + json_document(2) + json_document(3),
+        std::string("abcabcabcabcabcabcabcabcabcabcabcabc") + noise.substr(0, 100)
+    };
+    for (const std::string &input : inputs)
+        EXPECT_EQ(input, round_trip(input)) << input.size();
+
+    std::string compressed;
+    sqlite::lz_codec()->compress(inputs[3].data(), inputs[3].size(), compressed);
+    EXPECT_LT(compressed.size(), inputs[3].size() / 100);
+}
+
+TEST_F(codec, lz_rejects_corrupt_input) {
+    std::string input(json_document(7)), compressed, output;
+    auto lz(sqlite::lz_codec());
+    lz->compress(input.data(), input.size(), compressed);
+    EXPECT_THROW(
+        lz->decompress(compressed.data(), compressed.size() - 3, input.size(), output),
+        sqlite::error
+    );
+    EXPECT_THROW(
+        lz->decompress(compressed.data(), compressed.size(), input.size() + 1, output),
+        sqlite::error
+    );
+    std::string bad_offset("\x04" "abcd" "\xff\x00", 7);
+    EXPECT_THROW(lz->decompress(bad_offset.data(), bad_offset.size(), 8, output), sqlite::error);
+}
+
+TEST_F(codec, compresses_on_bind_and_decompresses_on_read) {
+    sqlite::column_codec payloads;
+    auto insert(db.prepare_statement("INSERT INTO documents (id, payload) VALUES (?, ?);"));
+    std::string document(json_document(1) + json_document(2));
+    insert.bind(1, 1);
+    payloads.bind(insert, 2, document);
+    (void) db.exec(insert);
+    (void) db.execute("INSERT INTO documents (id, payload) VALUES (2, 'plain text');");
+    (void) db.execute("INSERT INTO documents (id, payload) VALUES (3, NULL);");
+
+    EXPECT_LT(
+        db.execute_scalar<std::size_t>("SELECT length(payload) FROM documents WHERE id = 1;"),
+        document.size() / 2
+    );
+    std::vector<std::string> read;
+    for (const sqlite::row &row : db.execute("SELECT payload FROM documents ORDER BY id;"))
+        read.push_back(payloads.read(row[0]));
+    EXPECT_EQ((std::vector<std::string>{document, "plain text", ""}), read);
+}
+
+TEST_F(codec, bound_values_do_not_depend_on_the_codec) {
+    auto insert(db.prepare_statement("INSERT INTO documents (id, payload) VALUES (?, ?);"));
+    {
+        sqlite::column_codec payloads;
+        insert.bind(1, 1);
+        payloads.bind(insert, 2, json_document(1));
+        auto other(db.prepare_statement("SELECT ?;"));
+        payloads.bind(other, 1, json_document(2));
+    }
+    (void) db.exec(insert);
+    sqlite::column_codec payloads;
+    std::vector<std::string> read;
+    for (const sqlite::row &row : db.execute("SELECT payload FROM documents;"))
+        read.push_back(payloads.read(row[0]));
+    EXPECT_EQ(std::vector<std::string>{json_document(1)}, read);
+}
+
+TEST_F(codec, compressed_columns_stay_queryable) {
+    auto insert(db.prepare_statement(
+        "INSERT INTO documents (id, payload) VALUES (?, lz_compress(?));"
+    ));
+    for (int id(1); id <= 10; ++id) {
+        auto document(json_document(id));
+        insert.bind(1, id);
+        insert.bind(2, document);
+        (void) db.exec(insert);
+    }
+    EXPECT_EQ("blob", db.execute_scalar<std::string>(
+        "SELECT typeof(payload) FROM documents WHERE id = 4;"
+    ));
+    EXPECT_EQ(json_document(4), db.execute_scalar<std::string>(
+        "SELECT lz_decompress(payload) FROM documents WHERE id = 4;"
+    ));
+    EXPECT_EQ(7, db.execute_scalar<int>(
+        "SELECT id FROM documents"
+        " WHERE json_extract(lz_decompress(payload), '$.id') = 7;"
+    ));
+    EXPECT_EQ("blob", db.execute_scalar<std::string>(
+        "SELECT typeof(lz_decompress(lz_compress(x'00010203')));"
+    ));
+    EXPECT_TRUE(db.execute(
+        "SELECT lz_decompress(NULL) IS NULL;"
+    ).begin()->operator[](0).as<bool>());
+    EXPECT_THROW(db.execute("SELECT lz_decompress(x'0102');"), sqlite::error);
+}
+
+TEST_F(codec, small_and_incompressible_values_are_stored_raw) {
+    sqlite::column_codec payloads(sqlite::lz_codec(), 64);
+    auto insert(db.prepare_statement("INSERT INTO documents (id, payload) VALUES (:id, :payload);"));
+    std::string small("tiny");
+    insert.bind(":id", 1);
+    payloads.bind(insert, ":payload", small);
+    (void) db.exec(insert);
+    EXPECT_EQ(small.size() + 2, db.execute_scalar<std::size_t>(
+        "SELECT length(payload) FROM documents WHERE id = 1;"
+    ));
+    EXPECT_EQ(small, db.execute_scalar<std::string>(
+        "SELECT lz_decompress(payload) FROM documents WHERE id = 1;"
+    ));
+}
+
+TEST_F(codec, custom_codecs_register_their_own_functions) {
+    auto reversed(std::make_shared<reversing_codec>());
+    db.register_codec(reversed);
+    sqlite::column_codec payloads(reversed, 0);
+    auto insert(db.prepare_statement("INSERT INTO documents (id, payload) VALUES (1, ?);"));
+    std::string text("xabcdef");
+    payloads.bind(insert, 1, text);
+    (void) db.exec(insert);
+    EXPECT_EQ(text, db.execute_scalar<std::string>(
+        "SELECT reversed_decompress(payload) FROM documents;"
+    ));
+    auto rows(db.execute("SELECT payload FROM documents;"));
+    EXPECT_EQ(text, payloads.read(rows.begin()->operator[](0)));
+}
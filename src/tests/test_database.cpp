@@ -20,6 +20,11 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST(database, executes_valid_sql_sucessfully) {
     sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
     EXPECT_NO_THROW({
@@ -98,3 +103,158 @@ TEST(database, can_report_its_size) {
     std::size_t page_count(db.execute_scalar<std::size_t>("PRAGMA page_count;"));
     EXPECT_EQ(page_size * page_count, db.size());
 }
+
+TEST(database, executes_every_statement_in_a_script) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    EXPECT_EQ(3, db.execute_script(
+        "CREATE TABLE test (id INTEGER, value TEXT);\n"
+        "-- seed data\n"
+        "INSERT INTO test (id, value) VALUES (1, 'one');\n"
+        "INSERT INTO test (id, value) VALUES (2, 'two; still two');\n"
+        "/* trailing comment */  "
+    ));
+    EXPECT_EQ(2, db.execute_scalar<int>("SELECT count(*) FROM test;"));
+}
+
+TEST(database, stops_a_script_at_the_first_failing_statement) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    EXPECT_THROW(db.execute_script(
+        "CREATE TABLE test (id INTEGER PRIMARY KEY);"
+        "INSERT INTO test (id) VALUES (1);"
+        "INSERT INTO test (id) VALUES (1);"
+        "INSERT INTO test (id) VALUES (2);"
+    ), sqlite::error);
+    EXPECT_EQ(1, db.execute_scalar<int>("SELECT count(*) FROM test;"));
+    EXPECT_THROW(db.execute_script("SELECT 1; INVALID STATEMENT;"), sqlite::error);
+}
+
+TEST(database, reports_changes_and_rowid_when_executing_without_results) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    (void) db.execute("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+    sqlite::statement insert(db.prepare_statement(
+        "INSERT INTO test (value) VALUES (:value);"
+    ));
+    insert.bind(":value", "one");
+    EXPECT_EQ(1, db.exec(insert).last_insert_rowid);
+    insert.bind(":value", "two");
+    sqlite::exec_status status(db.exec(insert));
+    EXPECT_EQ(1, status.changes);
+    EXPECT_EQ(2, status.last_insert_rowid);
+    sqlite::statement update(db.prepare_statement("UPDATE test SET value = 'x';"));
+    EXPECT_EQ(2, db.exec(update).changes);
+    sqlite::statement query(db.prepare_statement("SELECT * FROM test;"));
+    EXPECT_EQ(0, db.exec(query).changes);
+}
+
+TEST(database, throws_transaction_failed_when_exec_meets_a_lock) {
+    sqlite::database db(
+        sqlite::in_memory, sqlite::read_write_create, sqlite::shared_cache
+    );
+    (void) db.execute("CREATE TABLE test (id INTEGER, value TEXT);");
+    (void) db.execute("BEGIN;");
+    (void) db.execute("INSERT INTO test (id, value) VALUES (1, '');");
+    sqlite::database db2(
+        sqlite::in_memory, sqlite::read_write, sqlite::shared_cache
+    );
+    sqlite::statement update(db2.prepare_statement("UPDATE test SET id = 2;"));
+    EXPECT_THROW(db2.exec(update), sqlite::transaction_failed);
+    (void) db.execute("COMMIT;");
+}
+
+TEST(database, leaves_a_moved_from_database_closed) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    (void) db.execute("CREATE TABLE test (id INTEGER);");
+    std::vector<sqlite::database> connections;
+    connections.push_back(std::move(db));
+    EXPECT_EQ(0, connections[0].execute_scalar<int>("SELECT count(*) FROM test;"));
+    sqlite::database other(sqlite::in_memory, sqlite::read_write_create);
+    other = std::move(connections[0]);
+    EXPECT_NO_THROW(other.execute("INSERT INTO test VALUES (1);"));
+}
+
+TEST(database, can_be_opened_without_a_connection_mutex) {
+    sqlite::database db(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::multi_thread
+    );
+    EXPECT_EQ(sqlite::multi_thread, db.threading());
+    EXPECT_EQ(1, db.execute_scalar<int>("SELECT 1;"));
+    sqlite::database serialized(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::serialized
+    );
+    EXPECT_EQ(sqlite::serialized, serialized.threading());
+}
+
+#ifndef NDEBUG
+TEST(database_death, asserts_when_a_multi_thread_connection_changes_thread) {
+    sqlite::database db(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::multi_thread
+    );
+    EXPECT_DEATH(
+        std::thread([&] { (void) db.execute("SELECT 1;"); }).join(),
+        "does not own it"
+    );
+    std::thread([&] {
+        db.claim_thread();
+        EXPECT_EQ(1, db.execute_scalar<int>("SELECT 1;"));
+    }).join();
+}
+#endif
+
+class attached_database: public testing::Test {
+protected:
+    attached_database():
+        path(testing::TempDir() + "xxsqlite_attach_test.db"),
+        db(sqlite::in_memory, sqlite::read_write_create) {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    ~attached_database() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    std::string path;
+    sqlite::database db;
+};
+
+TEST_F(attached_database, joins_across_schemas_until_the_handle_is_released) {
+    (void) db.execute("CREATE TABLE hot (id INTEGER PRIMARY KEY);");
+    (void) db.execute("INSERT INTO hot VALUES (1);");
+    {
+        auto archive(db.attach(path, "archive"));
+        EXPECT_EQ("archive", archive.schema());
+        EXPECT_EQ((std::vector<std::string>{"main", "archive"}), db.schemas());
+        (void) db.execute("CREATE TABLE archive.cold (id INTEGER PRIMARY KEY);");
+        (void) db.execute("INSERT INTO archive.cold VALUES (1);");
+        EXPECT_EQ(1, db.execute_scalar<int>(
+            "SELECT count(*) FROM hot JOIN archive.cold USING (id);"
+        ));
+    }
+    EXPECT_EQ(std::vector<std::string>{"main"}, db.schemas());
+    EXPECT_THROW(db.execute("SELECT * FROM archive.cold;"), sqlite::error);
+}
+
+TEST_F(attached_database, applies_per_schema_pragmas) {
+    sqlite::schema_options options;
+    options.cache_size = -512;
+    options.journal_mode = "wal";
+    options.synchronous = "off";
+    auto archive(db.attach(path, "archive", options));
+    EXPECT_EQ(-512, db.execute_scalar<int>("PRAGMA archive.cache_size;"));
+    EXPECT_EQ("wal", db.execute_scalar<std::string>("PRAGMA archive.journal_mode;"));
+    EXPECT_EQ(0, db.execute_scalar<int>("PRAGMA archive.synchronous;"));
+    EXPECT_EQ("memory", db.execute_scalar<std::string>("PRAGMA main.journal_mode;"));
+}
+
+TEST_F(attached_database, rejects_pragma_values_that_are_not_plain_words) {
+    sqlite::schema_options options;
+    options.synchronous = "off; DROP TABLE x";
+    EXPECT_THROW(db.attach(path, "archive", options), sqlite::error);
+    EXPECT_EQ(std::vector<std::string>{"main"}, db.schemas());
+}
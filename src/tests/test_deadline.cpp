@@ -0,0 +1,124 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "deadline.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const char *runaway_query(
+    "WITH RECURSIVE counter(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM counter) "
+    "SELECT count(*) FROM counter;"
+);
+
+const char *bounded_query(
+    "WITH RECURSIVE counter(x) AS "
+    "(SELECT 1 UNION ALL SELECT x + 1 FROM counter WHERE x < 100000) "
+    "SELECT count(*) FROM counter;"
+);
+
+}
+
+TEST(deadline, interrupts_a_query_that_runs_past_it) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::scoped_deadline deadline(db, std::chrono::milliseconds(20));
+    auto start(std::chrono::steady_clock::now());
+    EXPECT_THROW(db.execute_scalar<int>(runaway_query), sqlite::interrupted);
+    EXPECT_TRUE(deadline.expired());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(deadline, lets_a_query_finish_within_it) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::scoped_deadline deadline(db, std::chrono::seconds(60));
+    EXPECT_EQ(100000, db.execute_scalar<int>(bounded_query));
+    EXPECT_FALSE(deadline.expired());
+}
+
+TEST(deadline, is_removed_when_it_goes_out_of_scope) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    {
+        sqlite::scoped_deadline deadline(db, std::chrono::milliseconds(0));
+        EXPECT_THROW(db.execute_scalar<int>(bounded_query), sqlite::interrupted);
+    }
+    EXPECT_EQ(100000, db.execute_scalar<int>(bounded_query));
+}
+
+TEST(deadline, nested_deadlines_restore_the_outer_one) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::scoped_deadline outer(db, std::chrono::milliseconds(0));
+    {
+        sqlite::scoped_deadline inner(db, std::chrono::seconds(60));
+        EXPECT_TRUE(inner.expired());
+    }
+    EXPECT_THROW(db.execute_scalar<int>(bounded_query), sqlite::interrupted);
+}
+
+TEST(deadline, is_reported_by_the_non_throwing_api) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    auto query(db.prepare_statement(runaway_query));
+    sqlite::scoped_deadline deadline(db, std::chrono::milliseconds(20));
+    auto status(db.try_exec(query));
+    ASSERT_FALSE(status);
+    EXPECT_TRUE(status.error().is_interrupted());
+    EXPECT_THROW(status.value(), sqlite::interrupted);
+}
+
+TEST(cancel_token, interrupts_a_query_running_on_another_thread) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::cancel_token token(db);
+    std::atomic<bool> finished(false);
+    std::thread canceller([&] {
+        while (! finished) {
+            token.cancel();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+    EXPECT_THROW(db.execute_scalar<int>(runaway_query), sqlite::interrupted);
+    finished = true;
+    canceller.join();
+    EXPECT_TRUE(token.cancelled());
+    token.reset();
+    EXPECT_FALSE(token.cancelled());
+    EXPECT_EQ(100000, db.execute_scalar<int>(bounded_query));
+}
+
+TEST(cancel_token, interrupts_a_query_cancelled_before_it_starts) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::cancel_token token(db);
+    std::thread([&] { token.cancel(); }).join();
+    EXPECT_THROW(db.execute_scalar<int>(runaway_query), sqlite::interrupted);
+    EXPECT_THROW(db.execute_scalar<int>(bounded_query), sqlite::interrupted);
+    token.reset();
+    EXPECT_EQ(100000, db.execute_scalar<int>(bounded_query));
+}
+
+TEST(cancel_token, is_harmless_after_the_database_closes) {
+    std::unique_ptr<sqlite::database> db(
+        new sqlite::database(sqlite::in_memory, sqlite::read_write_create)
+    );
+    sqlite::cancel_token token(*db);
+    db.reset();
+    EXPECT_NO_THROW(token.cancel());
+}
@@ -0,0 +1,111 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "expected.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sqlite3.h>
+
+#include <mem/memory.hpp>
+
+class expected: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create, sqlite::shared_cache
+        );
+        (void) db->execute(
+            "CREATE TABLE test("
+            "    id INTEGER PRIMARY KEY,"
+            "    name TEXT"
+            ");"
+        );
+        (void) db->execute("INSERT INTO test (id, name) VALUES (1, 'one');");
+        (void) db->execute("INSERT INTO test (id, name) VALUES (2, 'two');");
+    }
+
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(expected, holds_the_value_of_a_successful_operation) {
+    auto insert(db->prepare_statement("INSERT INTO test (name) VALUES (?);"));
+    EXPECT_TRUE(insert.try_bind(1, "three"));
+    sqlite::expected<sqlite::exec_status> status(db->try_exec(insert));
+    ASSERT_TRUE(status);
+    EXPECT_EQ(1, status->changes);
+    EXPECT_EQ(3, status.value().last_insert_rowid);
+}
+
+TEST_F(expected, reports_failures_as_error_codes_without_throwing) {
+    auto insert(db->prepare_statement("INSERT INTO test (id) VALUES (:id);"));
+    EXPECT_EQ(SQLITE_RANGE, insert.try_bind(":missing", 1).error().code());
+    EXPECT_EQ(SQLITE_RANGE, insert.try_bind(2, 1).error().code());
+    ASSERT_TRUE(insert.try_bind(":id", 1));
+    sqlite::expected<sqlite::exec_status> status(db->try_exec(insert));
+    EXPECT_FALSE(status);
+    EXPECT_EQ(SQLITE_CONSTRAINT, status.error().code());
+    EXPECT_FALSE(status.error().is_busy());
+    EXPECT_NE(std::string::npos, status.error().message().find("INSERT INTO"));
+    EXPECT_THROW(status.value(), sqlite::error);
+}
+
+TEST_F(expected, keeps_sqlites_description_of_the_failure) {
+    auto insert(db->prepare_statement("INSERT INTO test (id) VALUES (1);"));
+    sqlite::expected<sqlite::exec_status> status(db->try_exec(insert));
+    ASSERT_FALSE(status);
+    (void) db->execute("SELECT 1;");
+    const char *description("UNIQUE constraint failed: test.id");
+    EXPECT_NE(std::string::npos, status.error().message().find(description));
+    try {
+        status.error().raise();
+        FAIL() << "raise() returned";
+    } catch (const sqlite::error &failure) {
+        EXPECT_NE(std::string::npos, std::string(failure.what()).find(description));
+    }
+}
+
+TEST_F(expected, reports_lock_contention_as_busy) {
+    (void) db->execute("BEGIN;");
+    (void) db->execute("UPDATE test SET name = 'locked';");
+    sqlite::database other(
+        sqlite::in_memory, sqlite::read_write, sqlite::shared_cache
+    );
+    auto update(other.prepare_statement("UPDATE test SET name = 'other';"));
+    sqlite::expected<sqlite::exec_status> status(other.try_exec(update));
+    EXPECT_TRUE(status.error().is_busy());
+    EXPECT_THROW(status.value(), sqlite::transaction_failed);
+    (void) db->execute("COMMIT;");
+    status = other.try_exec(update);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(2, status->changes);
+}
+
+TEST_F(expected, steps_through_results_without_throwing) {
+    auto query(db->prepare_statement("SELECT id FROM test ORDER BY id;"));
+    sqlite::expected<sqlite::result> results(db->try_execute(query));
+    ASSERT_TRUE(results);
+    EXPECT_EQ(1, (*results->begin())[0].as<int>());
+    sqlite::expected<bool> stepped(results->try_step());
+    ASSERT_TRUE(stepped);
+    EXPECT_TRUE(*stepped);
+    EXPECT_EQ(2, (*results->begin())[0].as<int>());
+    EXPECT_FALSE(*results->try_step());
+    EXPECT_TRUE(results->begin() == results->end());
+}
@@ -0,0 +1,131 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "governor.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <vector>
+
+class governor: public testing::Test {
+protected:
+    void TearDown() {
+        (void) sqlite::set_page_cache_budget(0);
+        (void) sqlite::set_soft_heap_limit(0);
+        (void) sqlite::set_hard_heap_limit(0);
+    }
+
+    static int64_t cache_size(sqlite::database &db) {
+        return db.execute_scalar<int64_t>("PRAGMA cache_size;");
+    }
+};
+
+TEST_F(governor, sets_and_reports_heap_limits) {
+    (void) sqlite::set_soft_heap_limit(64 * 1024 * 1024);
+    (void) sqlite::set_hard_heap_limit(128 * 1024 * 1024);
+    auto usage(sqlite::memory_usage());
+    EXPECT_EQ(64 * 1024 * 1024, usage.soft_limit);
+    EXPECT_EQ(128 * 1024 * 1024, usage.hard_limit);
+    EXPECT_EQ(64 * 1024 * 1024, sqlite::set_soft_heap_limit(0));
+}
+
+TEST_F(governor, splits_the_page_cache_budget_between_connections) {
+    std::vector<sqlite::database> connections;
+    for (int i(0); i < 4; ++i)
+        connections.emplace_back(sqlite::in_memory, sqlite::read_write_create);
+    (void) sqlite::set_page_cache_budget(4 * 1024 * 1024);
+    for (sqlite::database &db : connections)
+        EXPECT_EQ(-1024, cache_size(db));
+
+    connections.emplace_back(sqlite::in_memory, sqlite::read_write_create);
+    for (sqlite::database &db : connections)
+        EXPECT_EQ(-819, cache_size(db));
+
+    connections.pop_back();
+    connections.pop_back();
+    for (sqlite::database &db : connections)
+        EXPECT_EQ(-1365, cache_size(db));
+    EXPECT_EQ(4 * 1024 * 1024, sqlite::memory_usage().page_cache_budget);
+}
+
+TEST_F(governor, multi_thread_connections_apply_their_share_themselves) {
+    sqlite::database confined(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::multi_thread
+    );
+    sqlite::database shared(sqlite::in_memory, sqlite::read_write_create);
+    (void) sqlite::set_page_cache_budget(4 * 1024 * 1024);
+    EXPECT_EQ(-2048, cache_size(confined));
+    EXPECT_EQ(-2048, cache_size(shared));
+}
+
+TEST_F(governor, releases_cached_pages_from_every_connection) {
+    auto path(testing::TempDir() + "xxsqlite_governor_test.db");
+    std::remove(path.c_str());
+    {
+        sqlite::database db(path, sqlite::read_write_create);
+        (void) db.execute_script(
+            "CREATE TABLE blobs (id INTEGER PRIMARY KEY, data BLOB);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n"
+            " WHERE i < 200) INSERT INTO blobs (data) SELECT randomblob(4000)"
+            " FROM n;"
+        );
+        (void) db.execute_scalar<int64_t>("SELECT sum(length(data)) FROM blobs;");
+        auto before(sqlite::memory_usage().page_cache_used);
+        EXPECT_GT(sqlite::release_memory(), 0);
+        EXPECT_LT(sqlite::memory_usage().page_cache_used, before);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(governor, reports_connections_and_usage) {
+    auto baseline(sqlite::memory_usage().connections);
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::database confined(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::multi_thread
+    );
+    auto usage(sqlite::memory_usage());
+    EXPECT_EQ(baseline + 2, usage.connections);
+    EXPECT_EQ(1u, usage.unmanaged_connections);
+    EXPECT_GT(usage.used, 0);
+    EXPECT_GE(usage.high_water, usage.used);
+}
+
+TEST_F(governor, monitor_releases_memory_under_pressure) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    std::atomic<int64_t> reported(0);
+    {
+        sqlite::memory_pressure_monitor monitor(
+            1,
+            [&reported](const sqlite::memory_statistics &usage) {
+                reported = usage.used;
+            },
+            std::chrono::milliseconds(1)
+        );
+        auto until(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+        while (! monitor.releases() && std::chrono::steady_clock::now() < until)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_GT(monitor.releases(), 0u);
+    }
+    EXPECT_GT(reported.load(), 1);
+}
@@ -0,0 +1,139 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "importer.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <mem/memory.hpp>
+
+class importer: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create
+        );
+        (void) db->execute(
+            "CREATE TABLE test("
+            "    id INTEGER PRIMARY KEY,"
+            "    name TEXT,"
+            "    score REAL"
+            ");"
+        );
+        path = testing::TempDir() + "xxsqlite_import_test.csv";
+    }
+
+    void TearDown() {
+        std::remove(path.c_str());
+    }
+
+    void write_csv(const std::string &contents) {
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    sqlite::import_report import(const sqlite::csv_options &options) {
+        sqlite::statement insert(db->prepare_statement(
+            "INSERT INTO test (id, name, score) VALUES (?, ?, ?);"
+        ));
+        return sqlite::import_csv(*db, path, insert, options);
+    }
+
+    std::unique_ptr<sqlite::database> db;
+    std::string path;
+};
+
+TEST_F(importer, inserts_every_record_after_the_header) {
+    write_csv("id,name,score\n1,one,1.5\n2,two,2.5\r\n3,three,3.5");
+    sqlite::import_report report(import(sqlite::csv_options()));
+    EXPECT_EQ(3, report.rows_imported);
+    EXPECT_EQ(0, report.rows_rejected);
+    EXPECT_EQ(3, db->execute_scalar<int>("SELECT count(*) FROM test;"));
+    EXPECT_EQ("two", db->execute_scalar<std::string>(
+        "SELECT name FROM test WHERE id = 2;"
+    ));
+}
+
+TEST_F(importer, unescapes_quoted_fields_containing_delimiters_and_newlines) {
+    write_csv("1,\"a, \"\"quoted\"\"\nvalue\",0\n2,\"\",0\n");
+    sqlite::csv_options options;
+    options.has_header = false;
+    sqlite::import_report report(import(options));
+    EXPECT_EQ(2, report.rows_imported);
+    EXPECT_EQ("a, \"quoted\"\nvalue", db->execute_scalar<std::string>(
+        "SELECT name FROM test WHERE id = 1;"
+    ));
+    EXPECT_EQ("", db->execute_scalar<std::string>(
+        "SELECT name FROM test WHERE id = 2;"
+    ));
+}
+
+TEST_F(importer, converts_typed_columns_and_rejects_unconvertible_lines) {
+    write_csv("id;name;score\n1;one;1.5\nx;two;2\n3;three;\n4;four\n5;five;nan?\n");
+    sqlite::csv_options options;
+    options.delimiter = ';';
+    options.columns = {
+        sqlite::csv_column::integer,
+        sqlite::csv_column::text,
+        sqlite::csv_column::real
+    };
+    sqlite::import_report report(import(options));
+    EXPECT_EQ(2, report.rows_imported);
+    EXPECT_EQ(3, report.rows_rejected);
+    EXPECT_EQ((std::vector<std::size_t>{3, 5, 6}), report.rejected_lines);
+    EXPECT_EQ("real", db->execute_scalar<std::string>(
+        "SELECT typeof(score) FROM test WHERE id = 1;"
+    ));
+    EXPECT_EQ("null", db->execute_scalar<std::string>(
+        "SELECT typeof(score) FROM test WHERE id = 3;"
+    ));
+}
+
+TEST_F(importer, rejects_lines_that_violate_constraints) {
+    write_csv("1,one,1\n1,again,2\n2,two,3\n");
+    sqlite::csv_options options;
+    options.has_header = false;
+    options.rows_per_transaction = 2;
+    sqlite::import_report report(import(options));
+    EXPECT_EQ(2, report.rows_imported);
+    EXPECT_EQ(std::vector<std::size_t>{2}, report.rejected_lines);
+}
+
+TEST_F(importer, gives_the_same_result_when_parsing_in_the_background) {
+    std::string contents("id,name,score\n");
+    for (int i(1); i <= 1000; ++i)
+        contents += std::to_string(i) + ",name" + std::to_string(i) + ",0.5\n";
+    write_csv(contents);
+    sqlite::csv_options options;
+    options.rows_per_transaction = 64;
+    options.parse_in_background = true;
+    sqlite::import_report report(import(options));
+    EXPECT_EQ(1000, report.rows_imported);
+    EXPECT_EQ(1000, db->execute_scalar<int>("SELECT count(*) FROM test;"));
+    EXPECT_EQ("name1000", db->execute_scalar<std::string>(
+        "SELECT name FROM test WHERE id = 1000;"
+    ));
+    EXPECT_LE(0.0, report.rows_per_second());
+}
+
+TEST_F(importer, throws_database_error_when_the_file_cannot_be_opened) {
+    EXPECT_THROW(import(sqlite::csv_options()), sqlite::error);
+}
@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "mapping.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <mem/memory.hpp>
+
+namespace {
+
+struct employee {
+    int id = 0;
+    std::string name;
+    double salary = 0.0;
+};
+
+}
+
+namespace sqlite {
+
+template<>
+struct mapping<employee> {
+    template<typename Object, typename Visitor>
+    static void members(Object &e, Visitor &visit) {
+        visit("id", e.id);
+        visit("name", e.name);
+        visit("salary", e.salary);
+    }
+};
+
+}
+
+class mapping: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create
+        );
+        (void) db->execute(
+            "CREATE TABLE employee("
+            "    id INTEGER PRIMARY KEY,"
+            "    name TEXT,"
+            "    salary REAL"
+            ");"
+        );
+    }
+
+    void insert(const employee &e) {
+        auto stmt(db->prepare_statement(
+            "INSERT INTO employee (id, name, salary) "
+            "VALUES (:id, @name, $salary);"
+        ));
+        stmt.bind(e);
+        (void) db->exec(stmt);
+    }
+
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(mapping, binds_struct_members_to_named_parameters) {
+    insert({1, "J. Smith", 1000.5});
+    EXPECT_EQ("J. Smith", db->execute_scalar<std::string>(
+        "SELECT name FROM employee WHERE id = 1;"
+    ));
+    EXPECT_DOUBLE_EQ(1000.5, db->execute_scalar<double>(
+        "SELECT salary FROM employee WHERE id = 1;"
+    ));
+}
+
+TEST_F(mapping, skips_members_without_a_matching_parameter) {
+    insert({1, "J. Smith", 1000.5});
+    auto stmt(db->prepare_statement(
+        "UPDATE employee SET salary = :salary WHERE id = :id;"
+    ));
+    stmt.bind(employee{1, "ignored", 2000.0});
+    EXPECT_EQ(1, db->exec(stmt).changes);
+    EXPECT_EQ("J. Smith", db->execute_scalar<std::string>(
+        "SELECT name FROM employee WHERE id = 1;"
+    ));
+}
+
+TEST_F(mapping, decodes_rows_into_structs_by_column_name) {
+    insert({1, "J. Smith", 1000.5});
+    insert({2, "A. Jones", 2000.0});
+    auto query(db->prepare_statement(
+        "SELECT salary, name, id FROM employee ORDER BY id;"
+    ));
+    std::vector<employee> employees;
+    for (int pass(0); pass < 2; ++pass) {
+        sqlite::result results(db->execute(query));
+        for (const sqlite::row &row : results)
+            employees.push_back(row.as<employee>());
+    }
+    ASSERT_EQ(4, employees.size());
+    EXPECT_EQ(1, employees[0].id);
+    EXPECT_EQ("J. Smith", employees[0].name);
+    EXPECT_EQ(2, employees[3].id);
+    EXPECT_DOUBLE_EQ(2000.0, employees[3].salary);
+}
+
+TEST_F(mapping, throws_error_when_a_mapped_column_is_missing) {
+    insert({1, "J. Smith", 1000.5});
+    sqlite::result results(db->execute("SELECT id FROM employee;"));
+    EXPECT_DEBUG_DEATH((*results.begin()).as<employee>(), "");
+}
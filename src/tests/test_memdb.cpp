@@ -0,0 +1,105 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "memdb.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+class memdb: public testing::Test {
+protected:
+    memdb(): db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute_script(
+            "CREATE TABLE lookup (id INTEGER PRIMARY KEY, name TEXT);"
+            "INSERT INTO lookup (name) VALUES ('one'), ('two'), ('three');"
+        );
+    }
+
+    int count(sqlite::database &connection) {
+        return connection.execute_scalar<int>("SELECT count(*) FROM lookup;");
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(memdb, round_trips_a_database_through_an_image) {
+    auto image(db.serialize());
+    EXPECT_FALSE(image.empty());
+    EXPECT_EQ(db.size(), image.size());
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    copy.deserialize(image);
+    EXPECT_EQ(3, count(copy));
+    (void) copy.execute("INSERT INTO lookup (name) VALUES ('four');");
+    EXPECT_EQ(4, count(copy));
+    EXPECT_EQ(3, count(db));
+}
+
+TEST_F(memdb, image_is_unaffected_by_later_changes) {
+    auto image(db.serialize());
+    (void) db.execute("DELETE FROM lookup;");
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    copy.deserialize(image);
+    EXPECT_EQ(3, count(copy));
+}
+
+TEST_F(memdb, can_copy_an_image_from_a_buffer) {
+    auto image(db.serialize());
+    std::vector<unsigned char> buffer(image.data(), image.data() + image.size());
+    sqlite::memdb_image copied(buffer.data(), buffer.size());
+    buffer.assign(buffer.size(), 0);
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    copy.deserialize(copied);
+    EXPECT_EQ(3, count(copy));
+}
+
+TEST_F(memdb, maps_a_saved_image_read_only) {
+    std::string path(testing::TempDir() + "xxsqlite_memdb_test.img");
+    db.serialize().save(path);
+    {
+        sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+        copy.deserialize(sqlite::memdb_image(path), sqlite::read_only);
+        EXPECT_EQ(3, count(copy));
+        EXPECT_THROW(
+            copy.execute("INSERT INTO lookup (name) VALUES ('four');"),
+            sqlite::error
+        );
+    }
+    {
+        sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+        copy.deserialize(sqlite::memdb_image(path));
+        (void) copy.execute("INSERT INTO lookup (name) VALUES ('four');");
+        EXPECT_EQ(4, count(copy));
+    }
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    copy.deserialize(sqlite::memdb_image(path), sqlite::read_only);
+    EXPECT_EQ(3, count(copy));
+    std::remove(path.c_str());
+}
+
+TEST_F(memdb, throws_when_deserializing_an_invalid_image) {
+    const char garbage[] = "this is not a database file, not even close to one";
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    copy.deserialize(sqlite::memdb_image(garbage, sizeof(garbage)));
+    EXPECT_THROW(count(copy), sqlite::error);
+}
+
+TEST_F(memdb, throws_when_mapping_a_missing_file) {
+    EXPECT_THROW(sqlite::memdb_image("/nonexistent/image.db"), sqlite::error);
+}
@@ -0,0 +1,146 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "paged_cursor.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+class paged_cursor: public testing::Test {
+protected:
+    paged_cursor(): db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute_script(
+            "CREATE TABLE events (stream TEXT, sequence INTEGER, payload TEXT,"
+            " PRIMARY KEY (stream, sequence));"
+        );
+        auto insert(db.prepare_statement(
+            "INSERT INTO events (stream, sequence, payload) VALUES (?, ?, 'x');"
+        ));
+        std::vector<std::string> streams{"alpha", "beta", "gamma"};
+        sqlite::as_transaction(db, [&](sqlite::database &db) {
+            for (const std::string &stream : streams) {
+                for (int sequence(1); sequence <= 35; ++sequence) {
+                    insert.bind(1, stream);
+                    insert.bind(2, sequence);
+                    (void) db.exec(insert);
+                }
+            }
+        });
+    }
+
+    static std::string key(const sqlite::value_row &row) {
+        return row["stream"].as<std::string>() + "/" +
+            std::to_string(row["sequence"].as<int>());
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(paged_cursor, visits_every_row_once_in_key_order) {
+    sqlite::paged_cursor cursor(
+        db, "SELECT stream, sequence FROM events", {"stream", "sequence"}, 10
+    );
+    std::vector<std::string> seen;
+    std::pair<std::string, int> previous;
+    std::size_t pages(0);
+    while (! cursor.exhausted()) {
+        auto page(cursor.next_page());
+        EXPECT_LE(page.size(), 10u);
+        for (const sqlite::value_row &row : page) {
+            std::pair<std::string, int> current(
+                row["stream"].as<std::string>(), row["sequence"].as<int>()
+            );
+            EXPECT_LT(previous, current);
+            previous = current;
+            seen.push_back(key(row));
+        }
+        ++pages;
+    }
+    EXPECT_EQ(105u, seen.size());
+    EXPECT_EQ(11u, pages);
+    EXPECT_EQ(105u, std::set<std::string>(seen.begin(), seen.end()).size());
+    EXPECT_EQ("alpha/1", seen.front());
+    EXPECT_EQ("gamma/35", seen.back());
+    EXPECT_TRUE(cursor.next_page().empty());
+}
+
+TEST_F(paged_cursor, resumes_from_a_token_on_a_new_cursor) {
+    const std::string query("SELECT stream, sequence FROM events");
+    sqlite::paged_cursor cursor(db, query, {"stream", "sequence"}, 30);
+    (void) cursor.next_page();
+    auto token(cursor.resume_token());
+    auto expected(cursor.next_page());
+
+    sqlite::paged_cursor resumed(db, query, {"stream", "sequence"}, 30);
+    resumed.resume(token);
+    auto page(resumed.next_page());
+    ASSERT_EQ(expected.size(), page.size());
+    EXPECT_EQ("alpha/31", key(page.front()));
+    EXPECT_EQ(key(expected.back()), key(page.back()));
+}
+
+TEST_F(paged_cursor, seeks_through_user_parameters) {
+    sqlite::paged_cursor cursor(
+        db,
+        "SELECT sequence, payload FROM events WHERE stream = :stream;",
+        {"sequence"},
+        20
+    );
+    std::string stream("beta");
+    cursor.bind(":stream", stream);
+    std::size_t rows(0);
+    int last(0);
+    while (! cursor.exhausted()) {
+        for (const sqlite::value_row &row : cursor.next_page()) {
+            EXPECT_EQ(last + 1, row["sequence"].as<int>());
+            last = row["sequence"].as<int>();
+            ++rows;
+        }
+    }
+    EXPECT_EQ(35u, rows);
+    EXPECT_EQ(1u, cursor.position().size());
+    EXPECT_EQ(35, cursor.position()[0].as<int>());
+}
+
+TEST_F(paged_cursor, seek_uses_the_index_rather_than_a_scan) {
+    auto plan(db.explain(
+        "SELECT * FROM (SELECT stream, sequence FROM events)"
+        " WHERE (\"stream\", \"sequence\") > (?, ?)"
+        " ORDER BY \"stream\", \"sequence\" LIMIT ?;"
+    ));
+    EXPECT_FALSE(plan.has_full_scan());
+}
+
+TEST_F(paged_cursor, rejects_tokens_from_other_queries) {
+    sqlite::paged_cursor cursor(db, "SELECT stream, sequence FROM events", {"stream", "sequence"});
+    (void) cursor.next_page();
+    sqlite::paged_cursor other(db, "SELECT sequence, stream FROM events", {"stream", "sequence"});
+    EXPECT_THROW(other.resume(cursor.resume_token()), sqlite::error);
+    EXPECT_THROW(other.resume("not a token"), sqlite::error);
+    EXPECT_THROW(other.resume(cursor.resume_token().substr(0, 20)), sqlite::error);
+}
+
+TEST_F(paged_cursor, rejects_null_keys) {
+    (void) db.execute("INSERT INTO events (stream, sequence) VALUES (NULL, 1);");
+    sqlite::paged_cursor cursor(db, "SELECT stream, sequence FROM events", {"stream", "sequence"}, 1);
+    EXPECT_THROW(cursor.next_page(), sqlite::error);
+}
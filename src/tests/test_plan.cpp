@@ -0,0 +1,97 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "plan.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <mem/memory.hpp>
+
+class plan: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create
+        );
+        db->execute_script(
+            "CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT, code TEXT);"
+            "CREATE INDEX test_code ON test (code);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+            "WHERE i < 100) INSERT INTO test SELECT i, 'name' || i, 'c' || i "
+            "FROM n;"
+        );
+    }
+
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(plan, reports_a_full_scan_for_an_unindexed_filter) {
+    sqlite::query_plan plan(db->explain("SELECT * FROM test WHERE name = 'x';"));
+    ASSERT_EQ(1, plan.steps().size());
+    EXPECT_EQ(0, plan.steps()[0].detail.find("SCAN"));
+    EXPECT_TRUE(plan.has_full_scan());
+}
+
+TEST_F(plan, reports_no_full_scan_for_indexed_lookups) {
+    EXPECT_FALSE(db->explain("SELECT * FROM test WHERE id = 1;").has_full_scan());
+    EXPECT_FALSE(db->explain("SELECT * FROM test WHERE code = 'c1';").has_full_scan());
+    EXPECT_FALSE(db->explain("SELECT code FROM test;").has_full_scan());
+}
+
+TEST_F(plan, nests_steps_under_their_parents) {
+    sqlite::query_plan plan(db->explain(
+        "SELECT * FROM test WHERE id IN (SELECT id FROM test WHERE name = 'x') "
+        "UNION SELECT * FROM test WHERE code = 'c2';"
+    ));
+    std::size_t nested(0);
+    for (const sqlite::plan_step &step : plan.steps())
+        nested += step.children.size();
+    EXPECT_LT(0, nested);
+    EXPECT_TRUE(plan.has_full_scan());
+}
+
+TEST_F(plan, guard_reports_full_scans_when_statements_are_prepared) {
+    std::vector<sqlite::plan_warning> warnings;
+    db->enable_scan_guard([&](const sqlite::plan_warning &warning) {
+        warnings.push_back(warning);
+    });
+    (void) db->prepare_statement("SELECT * FROM test WHERE id = :id;");
+    EXPECT_TRUE(warnings.empty());
+    (void) db->prepare_statement("SELECT * FROM test WHERE name = :name;");
+    ASSERT_EQ(1, warnings.size());
+    EXPECT_EQ("SELECT * FROM test WHERE name = :name;", warnings[0].sql);
+    EXPECT_EQ(0, warnings[0].detail.find("SCAN"));
+
+    db->disable_scan_guard();
+    (void) db->prepare_statement("SELECT * FROM test WHERE name = :name;");
+    EXPECT_EQ(1, warnings.size());
+}
+
+TEST_F(plan, guard_reports_statements_crossing_the_full_scan_step_threshold) {
+    std::vector<sqlite::plan_warning> warnings;
+    db->enable_scan_guard([&](const sqlite::plan_warning &warning) {
+        if (warning.full_scan_steps)
+            warnings.push_back(warning);
+    }, 50);
+    (void) db->execute_scalar<int>("SELECT count(*) FROM test WHERE id < 10;");
+    EXPECT_TRUE(warnings.empty());
+    (void) db->execute_scalar<int>("SELECT count(*) FROM test WHERE name > '';");
+    ASSERT_EQ(1, warnings.size());
+    EXPECT_LE(50, warnings[0].full_scan_steps);
+}
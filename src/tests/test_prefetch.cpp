@@ -0,0 +1,120 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "prefetch.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <mem/memory.hpp>
+
+class prefetch: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create
+        );
+        (void) db->execute(
+            "CREATE TABLE test("
+            "    id INTEGER PRIMARY KEY,"
+            "    name TEXT,"
+            "    score REAL"
+            ");"
+        );
+        (void) db->execute(
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+            "WHERE i < 1000) INSERT INTO test SELECT i, 'name' || i, i * 0.5 "
+            "FROM n;"
+        );
+    }
+
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(prefetch, delivers_every_row_in_order) {
+    sqlite::prefetched_result rows(
+        db->execute("SELECT id, name, score FROM test ORDER BY id;"), 8
+    );
+    int expected(1);
+    for (const sqlite::value_row &row : rows) {
+        EXPECT_EQ(expected, row[0].as<int>());
+        EXPECT_EQ("name" + std::to_string(expected), row["name"].as<std::string>());
+        EXPECT_DOUBLE_EQ(expected * 0.5, row[2].as<double>());
+        ++expected;
+    }
+    EXPECT_EQ(1001, expected);
+    EXPECT_EQ(1000, rows.statistics().rows);
+    EXPECT_EQ(8, rows.statistics().depth);
+}
+
+TEST_F(prefetch, gives_same_iterator_for_begin_and_end_with_empty_data_set) {
+    sqlite::prefetched_result rows(
+        db->execute("SELECT id FROM test WHERE id > 5000;")
+    );
+    EXPECT_TRUE(rows.begin() == rows.end());
+    EXPECT_EQ(0, rows.statistics().rows);
+}
+
+TEST_F(prefetch, keeps_null_values_as_null) {
+    sqlite::prefetched_result rows(db->execute("SELECT NULL AS missing, 1;"));
+    auto row(rows.begin());
+    ASSERT_TRUE(row != rows.end());
+    EXPECT_TRUE((*row)["missing"].is_null());
+    EXPECT_EQ(sqlite::value_type::integer, (*row)[1].type());
+}
+
+TEST_F(prefetch, rounds_depth_up_to_a_power_of_two) {
+    sqlite::prefetched_result rows(db->execute("SELECT id FROM test;"), 100);
+    EXPECT_EQ(128, rows.statistics().depth);
+}
+
+TEST_F(prefetch, stops_the_producer_when_abandoned_early) {
+    sqlite::prefetched_result rows(db->execute("SELECT id FROM test;"), 2);
+    auto row(rows.begin());
+    EXPECT_EQ(1, row->operator[](0).as<int>());
+}
+
+TEST_F(prefetch, blocks_instead_of_spinning_while_the_consumer_is_slow) {
+    sqlite::prefetched_result rows(db->execute("SELECT id FROM test;"), 8);
+    auto row(rows.begin());
+    EXPECT_EQ(1, (*row)[0].as<int>());
+    std::clock_t started(std::clock());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double busy(double(std::clock() - started) / CLOCKS_PER_SEC);
+    EXPECT_LT(busy, 0.1);
+}
+
+TEST(prefetch_threading, hands_a_multi_thread_connection_to_the_producer) {
+    sqlite::database db(
+        sqlite::in_memory, sqlite::read_write_create,
+        sqlite::private_cache, sqlite::multi_thread
+    );
+    (void) db.execute("CREATE TABLE test (id INTEGER PRIMARY KEY);");
+    (void) db.execute("INSERT INTO test VALUES (1), (2), (3);");
+    int rows(0);
+    {
+        sqlite::prefetched_result prefetched(db.execute("SELECT id FROM test;"), 2);
+        for (const sqlite::value_row &row : prefetched)
+            rows += row[0].as<int>();
+    }
+    EXPECT_EQ(6, rows);
+    EXPECT_EQ(3, db.execute_scalar<int>("SELECT count(*) FROM test;"));
+}
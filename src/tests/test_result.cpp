@@ -22,6 +22,8 @@
 
 #include <mem/memory.hpp>
 
+#include <sstream>
+
 class result: public testing::Test {
 protected:
     void SetUp() {
@@ -91,3 +93,49 @@ TEST_F(result, asserts_or_throws_out_of_range_on_attempt_to_increment_past_end)
     EXPECT_NO_THROW(++it);
     EXPECT_DEBUG_DEATH(++it, "");
 }
+
+TEST_F(result, writes_remaining_rows_as_csv_with_a_header) {
+    sqlite::result results(db->execute("SELECT id, name FROM test;"));
+    std::stringstream csv;
+    EXPECT_EQ(3, results.write_csv(csv));
+    EXPECT_EQ("id,name\n1,testing\n2,result\n3,map\n", csv.str());
+    EXPECT_TRUE(results.begin() == results.end());
+}
+
+TEST_F(result, quotes_csv_fields_containing_delimiters_and_quotes) {
+    sqlite::result results(db->execute(
+        "SELECT 'a,b', 'say \"hi\"', 'two\nlines', NULL, 2.5, -7;"
+    ));
+    std::stringstream csv;
+    EXPECT_EQ(1, results.write_csv(csv, false));
+    EXPECT_EQ(
+        "\"a,b\",\"say \"\"hi\"\"\",\"two\nlines\",,2.5,-7\n", csv.str()
+    );
+}
+
+TEST_F(result, writes_remaining_rows_as_json_lines) {
+    sqlite::result results(db->execute(
+        "SELECT id, name, NULL AS missing FROM test WHERE id < 3;"
+    ));
+    std::stringstream json;
+    EXPECT_EQ(2, results.write_jsonl(json));
+    EXPECT_EQ(
+        "{\"id\":1,\"name\":\"testing\",\"missing\":null}\n"
+        "{\"id\":2,\"name\":\"result\",\"missing\":null}\n",
+        json.str()
+    );
+}
+
+TEST_F(result, escapes_json_strings_and_formats_numbers_exactly) {
+    sqlite::result results(db->execute(
+        "SELECT 'q\"b\\' || char(9) || char(1) AS \"t\", 0.1 AS r, 3.0 AS w, "
+        "-9223372036854775808 AS i, x'00ff' AS b;"
+    ));
+    std::stringstream json;
+    EXPECT_EQ(1, results.write_jsonl(json));
+    EXPECT_EQ(
+        "{\"t\":\"q\\\"b\\\\\\t\\u0001\",\"r\":0.1,\"w\":3.0,"
+        "\"i\":-9223372036854775808,\"b\":\"00ff\"}\n",
+        json.str()
+    );
+}
@@ -0,0 +1,162 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "result_cache.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include <cstdio>
+
+class result_cache: public testing::Test {
+protected:
+    result_cache(): db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute_script(
+            "CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT);"
+            "INSERT INTO test (name) VALUES ('one'), ('two'), ('three');"
+        );
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(result_cache, returns_cached_rows_for_a_repeated_query) {
+    sqlite::result_cache cache(db);
+    auto first(cache.execute("SELECT name FROM test ORDER BY id;"));
+    auto second(cache.execute("SELECT name FROM test ORDER BY id;"));
+    ASSERT_EQ(3u, first->size());
+    EXPECT_EQ("two", (*first)[1]["name"].as<std::string>());
+    EXPECT_EQ(first, second);
+    auto stats(cache.statistics());
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(1u, stats.entries);
+    EXPECT_DOUBLE_EQ(0.5, stats.hit_rate());
+}
+
+TEST_F(result_cache, keys_entries_on_the_bound_values) {
+    sqlite::result_cache cache(db);
+    auto query(db.prepare_statement("SELECT name FROM test WHERE id = ?;"));
+    query.bind(1, 1);
+    EXPECT_EQ("one", (*cache.execute(query))[0][0].as<std::string>());
+    query.bind(1, 2);
+    EXPECT_EQ("two", (*cache.execute(query))[0][0].as<std::string>());
+    query.bind(1, 1);
+    EXPECT_EQ("one", (*cache.execute(query))[0][0].as<std::string>());
+    EXPECT_EQ(1u, cache.statistics().hits);
+    EXPECT_EQ(2u, cache.statistics().entries);
+}
+
+TEST_F(result_cache, keys_reals_on_every_digit) {
+    (void) db.execute("CREATE TABLE readings (value REAL);");
+    auto insert(db.prepare_statement("INSERT INTO readings VALUES (?);"));
+    insert.bind(1, 0.1 + 0.2);
+    (void) db.execute(insert);
+    auto query(db.prepare_statement("SELECT count(*) FROM readings WHERE value = ?;"));
+    query.bind(1, 0.3);
+    sqlite::result_cache cache(db);
+    EXPECT_EQ(0, (*cache.execute(query))[0][0].as<int>());
+    EXPECT_EQ(1u, cache.statistics().bypassed);
+    query.bind(1, 0.3);
+    EXPECT_EQ(0, (*cache.execute(query))[0][0].as<int>());
+    query.bind(1, 0.30000000000000004);
+    EXPECT_EQ(1, (*cache.execute(query))[0][0].as<int>());
+    EXPECT_EQ(2u, cache.statistics().entries);
+}
+
+TEST_F(result_cache, only_captures_bindings_on_its_own_connection) {
+    sqlite3 *other(nullptr);
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(":memory:", &other));
+    sqlite3_stmt *stmt(nullptr);
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(other, "SELECT ?;", -1, &stmt, nullptr));
+    sqlite::result_cache cache(db);
+    EXPECT_EQ(nullptr, sqlite::detail::capturing_bindings(stmt));
+    (void) sqlite3_finalize(stmt);
+    (void) sqlite3_close(other);
+}
+
+TEST_F(result_cache, is_invalidated_by_writes_on_the_same_connection) {
+    sqlite::result_cache cache(db);
+    EXPECT_EQ(3u, cache.execute("SELECT * FROM test;")->size());
+    (void) db.execute("INSERT INTO test (name) VALUES ('four');");
+    EXPECT_EQ(4u, cache.execute("SELECT * FROM test;")->size());
+    (void) db.execute("DROP TABLE test;");
+    (void) db.execute("CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT);");
+    EXPECT_EQ(0u, cache.execute("SELECT * FROM test;")->size());
+    EXPECT_EQ(2u, cache.statistics().invalidations);
+}
+
+TEST_F(result_cache, is_invalidated_by_commits_from_other_connections) {
+    std::string path(testing::TempDir() + "xxsqlite_result_cache_test.db");
+    std::remove(path.c_str());
+    {
+        sqlite::database reader(path, sqlite::read_write_create);
+        (void) reader.execute("CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        sqlite::database writer(path, sqlite::read_write);
+        sqlite::result_cache cache(reader);
+        EXPECT_EQ(0u, cache.execute("SELECT * FROM test;")->size());
+        (void) writer.execute("INSERT INTO test DEFAULT VALUES;");
+        EXPECT_EQ(1u, cache.execute("SELECT * FROM test;")->size());
+        EXPECT_EQ(0u, cache.statistics().hits);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(result_cache, evicts_the_least_recently_used_entry_to_stay_in_budget) {
+    sqlite::result_cache probe(db);
+    (void) probe.execute("SELECT name FROM test WHERE id = 1;");
+    sqlite::result_cache cache(db, probe.statistics().bytes * 2 + 16);
+    (void) cache.execute("SELECT name FROM test WHERE id = 1;");
+    (void) cache.execute("SELECT name FROM test WHERE id = 2;");
+    (void) cache.execute("SELECT name FROM test WHERE id = 1;");
+    (void) cache.execute("SELECT name FROM test WHERE id = 3;");
+    (void) cache.execute("SELECT name FROM test WHERE id = 1;");
+    auto stats(cache.statistics());
+    EXPECT_EQ(2u, stats.hits);
+    EXPECT_EQ(1u, stats.evictions);
+    EXPECT_EQ(2u, stats.entries);
+    EXPECT_LE(stats.bytes, probe.statistics().bytes * 2 + 16);
+}
+
+TEST_F(result_cache, bypasses_statements_that_write) {
+    sqlite::result_cache cache(db);
+    auto insert(db.prepare_statement(
+        "INSERT INTO test (name) VALUES ('four') RETURNING id;"
+    ));
+    EXPECT_EQ(4, (*cache.execute(insert))[0][0].as<int>());
+    EXPECT_EQ(5, (*cache.execute(insert))[0][0].as<int>());
+    EXPECT_EQ(2u, cache.statistics().bypassed);
+    EXPECT_EQ(0u, cache.statistics().entries);
+}
+
+TEST_F(result_cache, is_invalidated_when_schemas_are_attached_or_detached) {
+    std::string path(testing::TempDir() + "xxsqlite_result_cache_attach.db");
+    std::remove(path.c_str());
+    sqlite::result_cache cache(db);
+    {
+        auto archive(db.attach(path, "archive"));
+        (void) db.execute("CREATE TABLE archive.cold (id INTEGER PRIMARY KEY);");
+        EXPECT_EQ(0u, cache.execute("SELECT * FROM archive.cold;")->size());
+        sqlite::database writer(path, sqlite::read_write);
+        (void) writer.execute("INSERT INTO cold DEFAULT VALUES;");
+        EXPECT_EQ(1u, cache.execute("SELECT * FROM archive.cold;")->size());
+    }
+    EXPECT_THROW(cache.execute("SELECT * FROM archive.cold;"), sqlite::error);
+    std::remove(path.c_str());
+}
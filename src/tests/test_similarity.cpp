@@ -0,0 +1,147 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "similarity.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+std::vector<float> sequence(const std::size_t &count, const float &scale) {
+    std::vector<float> elements(count);
+    for (std::size_t i(0); i < count; ++i)
+        elements[i] = scale * std::sin(float(i + 1));
+    return elements;
+}
+
+} // namespace
+
+class similarity: public testing::Test {
+protected:
+    similarity(): db(sqlite::in_memory, sqlite::read_write_create) {
+        db.enable_vector_functions();
+    }
+
+    double evaluate(
+            const std::string &function,
+            const std::vector<float> &a,
+            const std::vector<float> &b
+    ) {
+        auto stmt(db.prepare_statement("SELECT " + function + "(?, ?);"));
+        auto first(sqlite::pack_vector(a)), second(sqlite::pack_vector(b));
+        stmt.bind(1, first);
+        stmt.bind(2, second);
+        return db.execute_scalar<double>(stmt);
+    }
+
+    sqlite::database db;
+};
+
+TEST_F(similarity, kernels_match_a_reference_for_every_tail_length) {
+    for (std::size_t count(0); count < 70; ++count) {
+        auto a(sequence(count, 1.5f)), b(sequence(count, -0.5f));
+        for (std::size_t i(0); i < count; ++i)
+            b[i] += 0.25f * i;
+        double dot(0.0), distance(0.0), aa(0.0), bb(0.0);
+        for (std::size_t i(0); i < count; ++i) {
+            dot += double(a[i]) * b[i];
+            distance += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+            aa += double(a[i]) * a[i];
+            bb += double(b[i]) * b[i];
+        }
+        double tolerance(1e-4 * (1.0 + count));
+        EXPECT_NEAR(dot, evaluate("vec_dot", a, b), tolerance) << count;
+        EXPECT_NEAR(std::sqrt(distance), evaluate("vec_l2", a, b), tolerance) << count;
+        if (count) {
+            EXPECT_NEAR(
+                1.0 - dot / std::sqrt(aa * bb),
+                evaluate("vec_cosine", a, b),
+                1e-5
+            ) << count;
+        }
+    }
+    EXPECT_NE(std::string(), sqlite::vector_instruction_set());
+}
+
+TEST_F(similarity, cosine_distance_of_parallel_and_opposite_vectors) {
+    std::vector<float> a{1.0f, 2.0f, 3.0f}, doubled{2.0f, 4.0f, 6.0f};
+    std::vector<float> opposite{-1.0f, -2.0f, -3.0f};
+    EXPECT_NEAR(0.0, evaluate("vec_cosine", a, doubled), 1e-6);
+    EXPECT_NEAR(2.0, evaluate("vec_cosine", a, opposite), 1e-6);
+    EXPECT_TRUE(db.execute(
+        "SELECT vec_cosine(zeroblob(8), zeroblob(8)) IS NULL;"
+    ).begin()->operator[](0).as<bool>());
+}
+
+TEST_F(similarity, rejects_mismatched_and_malformed_vectors) {
+    auto mismatched(db.prepare_statement("SELECT vec_dot(?, ?);"));
+    auto pair(sqlite::pack_vector({1.0f, 2.0f})), single(sqlite::pack_vector({1.0f}));
+    mismatched.bind(1, pair);
+    mismatched.bind(2, single);
+    EXPECT_THROW(db.execute_scalar<double>(mismatched), sqlite::error);
+    EXPECT_THROW(db.execute("SELECT vec_l2(x'010203', x'010203');"), sqlite::error);
+    EXPECT_THROW(db.execute("SELECT vec_l2('text', 'text');"), sqlite::error);
+    EXPECT_TRUE(db.execute(
+        "SELECT vec_dot(NULL, x'00000000') IS NULL;"
+    ).begin()->operator[](0).as<bool>());
+}
+
+TEST_F(similarity, top_k_returns_the_nearest_rows_in_order) {
+    (void) db.execute("CREATE TABLE items (id INTEGER PRIMARY KEY, embedding BLOB);");
+    auto insert(db.prepare_statement("INSERT INTO items (id, embedding) VALUES (?, ?);"));
+    for (int id(1); id <= 50; ++id) {
+        auto embedding(sqlite::pack_vector({float(id), 0.0f, 1.0f}));
+        insert.bind(1, id);
+        insert.bind(2, embedding);
+        (void) db.exec(insert);
+    }
+    auto nearest(db.prepare_statement(
+        "SELECT vec_top_k(3, id, vec_l2(embedding, ?)) FROM items;"
+    ));
+    auto query(sqlite::pack_vector({20.2f, 0.0f, 1.0f}));
+    nearest.bind(1, query);
+    EXPECT_EQ("[20,21,19]", db.execute_scalar<std::string>(nearest));
+    EXPECT_EQ("[]", db.execute_scalar<std::string>(
+        "SELECT vec_top_k(3, id, 1.0) FROM items WHERE id < 0;"
+    ));
+    EXPECT_EQ("[1,2]", db.execute_scalar<std::string>(
+        "SELECT vec_top_k(2, id, 0.0) FROM items;"
+    ));
+    EXPECT_THROW(db.execute("SELECT vec_top_k(0, id, 1.0) FROM items;"), sqlite::error);
+}
+
+TEST_F(similarity, packed_vectors_round_trip) {
+    std::vector<float> elements{0.5f, -1.25f, 3.0f};
+    auto packed(sqlite::pack_vector(elements));
+    EXPECT_EQ(sqlite::value_type::blob, packed.type());
+    EXPECT_EQ(elements, sqlite::unpack_vector(packed));
+    EXPECT_THROW(sqlite::unpack_vector(sqlite::value(int64_t(1))), sqlite::error);
+}
+
+TEST(similarity_registration, functions_are_only_available_on_request) {
+    sqlite::database db(sqlite::in_memory, sqlite::read_write_create);
+    EXPECT_THROW(db.execute("SELECT vec_dot(x'00000000', x'00000000');"), sqlite::error);
+    db.enable_vector_functions();
+    EXPECT_EQ(0.0, db.execute_scalar<double>(
+        "SELECT vec_dot(x'00000000', x'00000000');"
+    ));
+}
@@ -0,0 +1,149 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "snapshot.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <mem/memory.hpp>
+
+class snapshot: public testing::Test {
+protected:
+    void SetUp() {
+        path = testing::TempDir() + "xxsqlite_snapshot_test.db";
+        remove_files();
+        db = std::make_unique<sqlite::database>(path, sqlite::read_write_create);
+        (void) db->execute("PRAGMA journal_mode = WAL;");
+        (void) db->execute("CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        (void) db->execute("INSERT INTO test DEFAULT VALUES;");
+    }
+
+    void TearDown() {
+        db.reset();
+        remove_files();
+    }
+
+    void remove_files() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    int count(sqlite::database &connection) {
+        return connection.execute_scalar<int>("SELECT count(*) FROM test;");
+    }
+
+    std::string path;
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(snapshot, throws_when_sqlite_lacks_snapshot_support) {
+    if (sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built with SQLITE_ENABLE_SNAPSHOT";
+    EXPECT_THROW(sqlite::snapshot state(*db), sqlite::error);
+}
+
+TEST_F(snapshot, readers_see_the_state_at_the_time_it_was_taken) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    sqlite::database source(path, sqlite::read_write);
+    sqlite::database reader(path, sqlite::read_write);
+    sqlite::snapshot state(source);
+    (void) db->execute("INSERT INTO test DEFAULT VALUES;");
+    sqlite::snapshot_transaction transaction(reader, state);
+    EXPECT_EQ(1, count(reader));
+    EXPECT_EQ(1, count(source));
+    EXPECT_EQ(2, count(*db));
+}
+
+TEST_F(snapshot, can_be_opened_on_several_connections_in_parallel) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    sqlite::database source(path, sqlite::read_write);
+    sqlite::snapshot state(source);
+    (void) db->execute("INSERT INTO test DEFAULT VALUES;");
+    std::vector<sqlite::database> readers;
+    for (int i(0); i < 4; ++i)
+        readers.emplace_back(path, sqlite::read_write);
+    std::vector<int> counts(readers.size());
+    std::vector<std::thread> threads;
+    for (std::size_t i(0); i < readers.size(); ++i) {
+        threads.emplace_back([&, i] {
+            sqlite::snapshot_transaction transaction(readers[i], state);
+            counts[i] = count(readers[i]);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    EXPECT_EQ(std::vector<int>(readers.size(), 1), counts);
+}
+
+TEST_F(snapshot, releases_the_reader_when_the_transaction_ends) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    sqlite::database reader(path, sqlite::read_write);
+    {
+        sqlite::database source(path, sqlite::read_write);
+        sqlite::snapshot state(source);
+        (void) db->execute("INSERT INTO test DEFAULT VALUES;");
+        sqlite::snapshot_transaction transaction(reader, state);
+        EXPECT_EQ(1, count(reader));
+    }
+    EXPECT_EQ(2, count(reader));
+}
+
+TEST_F(snapshot, leaves_transactions_on_the_source_alone) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    sqlite::database source(path, sqlite::read_write);
+    {
+        sqlite::snapshot state(source);
+        (void) source.execute("BEGIN;");
+        (void) source.execute("INSERT INTO test DEFAULT VALUES;");
+    }
+    (void) source.execute("ROLLBACK;");
+    EXPECT_EQ(1, count(*db));
+}
+
+TEST_F(snapshot, throws_for_a_database_not_in_wal_mode) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    sqlite::database memory(sqlite::in_memory, sqlite::read_write_create);
+    EXPECT_THROW(sqlite::snapshot state(memory), sqlite::error);
+    EXPECT_NO_THROW(memory.execute("BEGIN;"));
+}
+
+TEST_F(snapshot, quotes_the_schema_name) {
+    if (! sqlite::snapshot::supported())
+        GTEST_SKIP() << "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+    const std::string schema("odd \"name\"");
+    sqlite::database source(sqlite::in_memory, sqlite::read_write_create);
+    sqlite::database reader(sqlite::in_memory, sqlite::read_write_create);
+    auto source_attachment(source.attach(path, schema));
+    auto reader_attachment(reader.attach(path, schema));
+    sqlite::snapshot state(source, schema);
+    (void) db->execute("INSERT INTO test DEFAULT VALUES;");
+    sqlite::snapshot_transaction transaction(reader, state);
+    EXPECT_EQ(1, reader.execute_scalar<int>(
+        "SELECT count(*) FROM \"odd \"\"name\"\"\".test;"
+    ));
+}
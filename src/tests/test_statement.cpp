@@ -85,3 +85,15 @@ TEST_F(statement, can_be_executed_with_more_than_one_bind_sets) {
         EXPECT_EQ(row["name"].as<std::string>(), expected.str());
     }
 }
+
+TEST_F(statement, binds_parameters_by_position) {
+    auto statement(db->prepare_statement(
+        "SELECT count(*) FROM test WHERE id = ? AND name = ?;"
+    ));
+    statement.bind(1, 3);
+    statement.bind(2, "test3", 5);
+    EXPECT_EQ(1, db->execute_scalar<int>(statement));
+    statement.bind(2, std::string("test4"));
+    EXPECT_EQ(0, db->execute_scalar<int>(statement));
+    EXPECT_THROW(statement.bind(3, 0), sqlite::error);
+}
@@ -0,0 +1,100 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "database.hpp"
+#include "static_statement.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <mem/memory.hpp>
+
+using find_name = sqlite::static_statement<
+    "SELECT name FROM test WHERE id = ?1;",
+    sqlite::parameters<int>,
+    sqlite::columns<std::string>
+>;
+
+using find_range = sqlite::static_statement<
+    "SELECT id, name FROM test WHERE id >= :low AND id <= :high "
+    "AND name <> ':ignored' AND id <> :low ORDER BY id;",
+    sqlite::parameters<int, int>,
+    sqlite::columns<int, std::string>
+>;
+
+using insert_row = sqlite::static_statement<
+    "INSERT INTO test (id, name) VALUES (?, ?);",
+    sqlite::parameters<int, std::string>
+>;
+
+static_assert(find_name::parameter_count == 1);
+static_assert(find_range::parameter_count == 2);
+static_assert(find_range::parameter_index<":low">() == 1);
+static_assert(find_range::parameter_index<":high">() == 2);
+static_assert(insert_row::parameter_count == 2);
+static_assert(sqlite::detail::parse_parameters<
+    "SELECT ?5, ?, @a, $b, @a -- :comment\n /* ?9 */ \"?\" [:x] `@y`"
+>().count == 8);
+
+class static_statement: public testing::Test {
+protected:
+    void SetUp() {
+        db = std::make_unique<sqlite::database>(
+            sqlite::in_memory, sqlite::read_write_create
+        );
+        (void) db->execute(
+            "CREATE TABLE test("
+            "    id INTEGER PRIMARY KEY,"
+            "    name TEXT"
+            ");"
+        );
+        for (int i(1); i <= 5; ++i)
+            (void) insert_row::execute(*db, i, "test" + std::to_string(i));
+    }
+
+    std::unique_ptr<sqlite::database> db;
+};
+
+TEST_F(static_statement, binds_declared_parameters_by_position) {
+    EXPECT_EQ(5, db->execute_scalar<int>("SELECT count(*) FROM test;"));
+    sqlite::result results(find_name::execute(*db, 3));
+    EXPECT_EQ("test3", std::get<0>(find_name::decode(*results.begin())));
+}
+
+TEST_F(static_statement, reuses_one_prepared_statement_per_connection) {
+    sqlite::statement &first(find_name::prepare(*db));
+    (void) find_name::execute(*db, 1);
+    EXPECT_EQ(&first, &find_name::prepare(*db));
+
+    sqlite::database other(sqlite::in_memory, sqlite::read_write_create);
+    (void) other.execute("CREATE TABLE test (id INTEGER, name TEXT);");
+    EXPECT_NE(&first, &find_name::prepare(other));
+}
+
+TEST_F(static_statement, decodes_rows_into_the_declared_column_types) {
+    sqlite::result results(find_range::execute(*db, 2, 4));
+    std::vector<find_range::row_type> rows;
+    for (const sqlite::row &row : results)
+        rows.push_back(find_range::decode(row));
+    ASSERT_EQ(2, rows.size());
+    EXPECT_EQ(find_range::row_type(3, "test3"), rows[0]);
+    EXPECT_EQ(find_range::row_type(4, "test4"), rows[1]);
+}
+
+TEST_F(static_statement, agrees_with_sqlite_on_parameter_numbering) {
+    sqlite::statement &stmt(find_range::prepare(*db));
+    EXPECT_EQ(find_range::parameter_count, stmt.parameter_count());
+}
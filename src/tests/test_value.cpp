@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "value.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(value, is_null_by_default) {
+    sqlite::value value;
+    EXPECT_TRUE(value.is_null());
+    EXPECT_FALSE(value);
+    EXPECT_EQ(0, value.as<int>());
+    EXPECT_EQ("", value.as<std::string>());
+}
+
+TEST(value, converts_between_numeric_types) {
+    sqlite::value integer(int64_t(42));
+    EXPECT_EQ(42, integer.as<int>());
+    EXPECT_DOUBLE_EQ(42.0, integer.as<double>());
+    EXPECT_EQ("42", integer.as<std::string>());
+    sqlite::value real(2.5);
+    EXPECT_EQ(2, real.as<int>());
+    EXPECT_EQ("2.5", real.as<std::string>());
+    EXPECT_EQ("3.0", sqlite::value(3.0).as<std::string>());
+}
+
+TEST(value, converts_text_to_numbers) {
+    sqlite::value text(std::string("17"));
+    EXPECT_EQ(sqlite::value_type::text, text.type());
+    EXPECT_EQ(17, text.as<int>());
+    EXPECT_TRUE(text.as<bool>());
+    EXPECT_EQ('1', text.as<char>());
+}
+
+TEST(value, compares_type_and_contents) {
+    EXPECT_EQ(sqlite::value(int64_t(1)), sqlite::value(int64_t(1)));
+    EXPECT_NE(sqlite::value(int64_t(1)), sqlite::value(1.0));
+    EXPECT_NE(
+        sqlite::value(std::string("a")),
+        sqlite::value(sqlite::value_type::blob, "a", 1)
+    );
+}
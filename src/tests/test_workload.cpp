@@ -0,0 +1,163 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "database.hpp"
+#include "workload.hpp"
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+
+class workload: public testing::Test {
+protected:
+    workload():
+        path(testing::TempDir() + "xxsqlite_workload_test.log"),
+        db(sqlite::in_memory, sqlite::read_write_create) {
+        (void) db.execute("CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT, score REAL);");
+    }
+
+    ~workload() {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+    sqlite::database db;
+};
+
+TEST_F(workload, records_statements_with_their_bound_values) {
+    db.start_recording(path);
+    auto insert(db.prepare_statement("INSERT INTO test (id, name, score) VALUES (?, ?, ?);"));
+    insert.bind(1, 1);
+    insert.bind(2, std::string("it's"));
+    insert.bind(3, 2.5);
+    (void) db.exec(insert);
+    insert.bind(1, -7);
+    insert.bind(2, sqlite::null);
+    insert.bind(3, 1e300);
+    (void) db.exec(insert);
+    db.stop_recording();
+
+    auto log(sqlite::read_workload(path));
+    ASSERT_EQ(1u, log.statements.size());
+    EXPECT_EQ("INSERT INTO test (id, name, score) VALUES (?, ?, ?);", log.statements[0]);
+    ASSERT_EQ(2u, log.events.size());
+    ASSERT_EQ(3u, log.events[0].parameters.size());
+    EXPECT_EQ(1, log.events[0].parameters[0].as<int>());
+    EXPECT_EQ("it's", log.events[0].parameters[1].as<std::string>());
+    EXPECT_DOUBLE_EQ(2.5, log.events[0].parameters[2].as<double>());
+    EXPECT_EQ(-7, log.events[1].parameters[0].as<int>());
+    EXPECT_TRUE(log.events[1].parameters[1].is_null());
+    EXPECT_DOUBLE_EQ(1e300, log.events[1].parameters[2].as<double>());
+    EXPECT_LE(log.events[0].offset, log.events[1].offset);
+}
+
+TEST_F(workload, maps_named_and_numbered_parameters_to_their_indices) {
+    db.start_recording(path);
+    auto query(db.prepare_statement(
+        "SELECT * FROM test WHERE name = :name -- a ? in a comment\n"
+        "AND id = ?3 AND score > @score AND 'a ? literal' <> :name;"
+    ));
+    query.bind(":name", std::string("x"));
+    query.bind(3, 42);
+    query.bind("@score", 0.5);
+    (void) db.exec(query);
+    db.stop_recording();
+
+    auto log(sqlite::read_workload(path));
+    ASSERT_EQ(1u, log.events.size());
+    const auto &parameters(log.events[0].parameters);
+    ASSERT_EQ(4u, parameters.size());
+    EXPECT_EQ("x", parameters[0].as<std::string>());
+    EXPECT_EQ(42, parameters[2].as<int>());
+    EXPECT_DOUBLE_EQ(0.5, parameters[3].as<double>());
+}
+
+TEST_F(workload, records_bound_values_exactly) {
+    db.start_recording(path);
+    auto insert(db.prepare_statement("INSERT INTO test (name, score) VALUES (?, ?);"));
+    insert.bind(1, std::string("? :name @score 'quoted' -- not a comment"));
+    insert.bind(2, 0.1 + 0.2);
+    (void) db.exec(insert);
+    db.stop_recording();
+
+    auto log(sqlite::read_workload(path));
+    ASSERT_EQ(1u, log.events.size());
+    const auto &parameters(log.events[0].parameters);
+    ASSERT_EQ(2u, parameters.size());
+    EXPECT_EQ(
+        "? :name @score 'quoted' -- not a comment",
+        parameters[0].as<std::string>()
+    );
+    EXPECT_EQ(0.1 + 0.2, parameters[1].as<double>());
+    EXPECT_NE(0.3, parameters[1].as<double>());
+}
+
+TEST_F(workload, replays_a_recording_against_another_database) {
+    db.start_recording(path);
+    auto insert(db.prepare_statement("INSERT INTO test (name) VALUES (?);"));
+    for (int i(0); i < 10; ++i) {
+        insert.bind(1, std::string("row ") + std::to_string(i));
+        (void) db.exec(insert);
+    }
+    (void) db.execute_scalar<int>("SELECT count(*) FROM test;");
+    db.stop_recording();
+
+    sqlite::database copy(sqlite::in_memory, sqlite::read_write_create);
+    (void) copy.execute("CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT, score REAL);");
+    auto latencies(sqlite::replay_workload(copy, sqlite::read_workload(path)));
+    ASSERT_EQ(2u, latencies.size());
+    EXPECT_EQ(10u, latencies[0].recorded.count);
+    EXPECT_EQ(10u, latencies[0].replayed.count);
+    EXPECT_EQ(0u, latencies[0].failures);
+    EXPECT_EQ(1u, latencies[1].replayed.count);
+    EXPECT_EQ("row 9", copy.execute_scalar<std::string>(
+        "SELECT name FROM test WHERE id = 10;"
+    ));
+}
+
+TEST_F(workload, keeps_the_scan_guard_running_while_recording) {
+    std::size_t warnings(0);
+    db.enable_scan_guard([&](const sqlite::plan_warning &) { ++warnings; }, 1);
+    db.start_recording(path);
+    (void) db.execute("INSERT INTO test (name) VALUES ('one'), ('two'), ('three');");
+    (void) db.execute_scalar<int>("SELECT count(*) FROM test WHERE name = 'one';");
+    db.stop_recording();
+    EXPECT_EQ(2u, sqlite::read_workload(path).events.size());
+    EXPECT_GT(warnings, 0u);
+}
+
+TEST(workload_summary, reports_nearest_rank_percentiles) {
+    std::vector<std::chrono::nanoseconds> samples;
+    for (int i(100); i >= 1; --i)
+        samples.push_back(std::chrono::nanoseconds(i));
+    auto summary(sqlite::summarise(samples));
+    EXPECT_EQ(100u, summary.count);
+    EXPECT_EQ(1, summary.min.count());
+    EXPECT_EQ(50, summary.p50.count());
+    EXPECT_EQ(90, summary.p90.count());
+    EXPECT_EQ(99, summary.p99.count());
+    EXPECT_EQ(100, summary.p999.count());
+    EXPECT_EQ(100, summary.max.count());
+    EXPECT_EQ(50, summary.mean.count());
+}
+
+TEST_F(workload, rejects_a_file_that_is_not_a_workload_log) {
+    std::ofstream(path) << "not a workload";
+    EXPECT_THROW(sqlite::read_workload(path), sqlite::error);
+}
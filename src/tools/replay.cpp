@@ -0,0 +1,101 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+// Replays a workload recorded with database::start_recording() against a
+// copy of a database and reports per statement latencies.
+//
+//   sqlite_replay [--original-pace] <workload log> <database> [copy]
+
+#include "database.hpp"
+#include "workload.hpp"
+#include "error.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+int usage() {
+    std::cerr << "usage: sqlite_replay [--original-pace] <workload log> "
+                 "<database> [copy]\n";
+    return 2;
+}
+
+double microseconds(const std::chrono::nanoseconds &duration) {
+    return duration.count() / 1000.0;
+}
+
+void print_distribution(const char *label, const sqlite::latency_distribution &latency) {
+    std::cout << "    " << std::left << std::setw(10) << label << std::right
+              << std::setw(8) << latency.count
+              << std::setw(12) << microseconds(latency.p50)
+              << std::setw(12) << microseconds(latency.p90)
+              << std::setw(12) << microseconds(latency.p99)
+              << std::setw(12) << microseconds(latency.max)
+              << std::setw(12) << microseconds(latency.mean) << "\n";
+}
+
+}
+
+int main(int argc, char *argv[]) try {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    auto pace(sqlite::replay_pace::fastest);
+    if (! arguments.empty() && arguments.front() == "--original-pace") {
+        pace = sqlite::replay_pace::original;
+        arguments.erase(arguments.begin());
+    }
+    if (arguments.size() < 2 || arguments.size() > 3)
+        return usage();
+    const std::string &log_path(arguments[0]);
+    const std::string &source_path(arguments[1]);
+    std::string copy_path(
+        arguments.size() == 3 ? arguments[2] : source_path + ".replay"
+    );
+
+    auto log(sqlite::read_workload(log_path));
+    {
+        std::remove(copy_path.c_str());
+        sqlite::database source(source_path, sqlite::read_only);
+        auto vacuum(source.prepare_statement("VACUUM INTO ?;"));
+        vacuum.bind(1, copy_path);
+        (void) source.exec(vacuum);
+    }
+    sqlite::database db(copy_path, sqlite::read_write);
+    auto latencies(sqlite::replay_workload(db, log, pace));
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "replayed " << log.events.size() << " statements against "
+              << copy_path << " (latencies in microseconds)\n";
+    for (const sqlite::statement_latency &latency : latencies) {
+        std::cout << "\n" << latency.sql << "\n"
+                  << "    " << std::left << std::setw(10) << "" << std::right
+                  << std::setw(8) << "count" << std::setw(12) << "p50"
+                  << std::setw(12) << "p90" << std::setw(12) << "p99"
+                  << std::setw(12) << "max" << std::setw(12) << "mean" << "\n";
+        print_distribution("recorded", latency.recorded);
+        print_distribution("replayed", latency.replayed);
+        if (latency.failures)
+            std::cout << "    failures  " << latency.failures << "\n";
+    }
+    return 0;
+} catch (const sqlite::error &failure) {
+    std::cerr << "sqlite_replay: " << failure.what() << "\n";
+    return 1;
+}
@@ -0,0 +1,353 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+// Measures throughput, tail latency and lock contention with concurrent
+// reader and writer threads, optionally spread over several processes, all
+// sharing one database file.
+//
+//   sqlite_stress [--database path] [--journal-mode wal] [--readers 4]
+//                 [--writers 1] [--processes 1] [--seconds 5] [--rows 10000]
+//                 [--batch 10] [--busy-timeout 0] [--retries 0]
+
+#include "database.hpp"
+#include "statement.hpp"
+#include "workload.hpp"
+#include "error.hpp"
+
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct options {
+    std::string database = "sqlite_stress.db";
+    std::string journal_mode = "wal";
+    int readers = 4;
+    int writers = 1;
+    int processes = 1;
+    double seconds = 5.0;
+    int rows = 10000;
+    int batch = 10;
+    int busy_timeout = 0;
+    int retries = 0;
+};
+
+struct outcome {
+    std::vector<std::chrono::nanoseconds> reads;
+    std::vector<std::chrono::nanoseconds> writes;
+    uint64_t busy = 0;
+    uint64_t errors = 0;
+
+    void merge(const outcome &other) {
+        reads.insert(reads.end(), other.reads.begin(), other.reads.end());
+        writes.insert(writes.end(), other.writes.begin(), other.writes.end());
+        busy += other.busy;
+        errors += other.errors;
+    }
+};
+
+options parse_options(int argc, char *argv[]) {
+    options parsed;
+    std::map<std::string, std::string> values;
+    for (int i(1); i + 1 < argc; i += 2)
+        values[argv[i]] = argv[i + 1];
+    if (argc % 2 == 0)
+        throw sqlite::error(std::string("missing value for ") + argv[argc - 1]);
+    for (const auto &option : values) {
+        const std::string &name(option.first);
+        const std::string &value(option.second);
+        if (name == "--database")          parsed.database = value;
+        else if (name == "--journal-mode") parsed.journal_mode = value;
+        else if (name == "--readers")      parsed.readers = std::stoi(value);
+        else if (name == "--writers")      parsed.writers = std::stoi(value);
+        else if (name == "--processes")    parsed.processes = std::stoi(value);
+        else if (name == "--seconds")      parsed.seconds = std::stod(value);
+        else if (name == "--rows")         parsed.rows = std::stoi(value);
+        else if (name == "--batch")        parsed.batch = std::stoi(value);
+        else if (name == "--busy-timeout") parsed.busy_timeout = std::stoi(value);
+        else if (name == "--retries")      parsed.retries = std::stoi(value);
+        else throw sqlite::error("unknown option " + name);
+    }
+    return parsed;
+}
+
+void prepare_database(const options &settings) {
+    std::remove(settings.database.c_str());
+    std::remove((settings.database + "-wal").c_str());
+    std::remove((settings.database + "-shm").c_str());
+    sqlite::database db(settings.database, sqlite::read_write_create);
+    auto mode(db.execute_scalar<std::string>(
+        "PRAGMA journal_mode = " + settings.journal_mode + ";"
+    ));
+    if (mode != settings.journal_mode)
+        throw sqlite::error("journal mode " + settings.journal_mode + " refused");
+    (void) db.execute("CREATE TABLE kv (id INTEGER PRIMARY KEY, value TEXT, version INTEGER);");
+    auto insert(db.prepare_statement("INSERT INTO kv (id, value, version) VALUES (?, ?, 0);"));
+    std::string value("initial value");
+    sqlite::as_transaction(db, [&](sqlite::database &db) {
+        for (int id(1); id <= settings.rows; ++id) {
+            insert.bind(1, id);
+            insert.bind(2, value);
+            (void) db.exec(insert);
+        }
+    });
+}
+
+sqlite::database open_connection(const options &settings) {
+    sqlite::database db(settings.database, sqlite::read_write);
+    (void) db.execute(
+        "PRAGMA busy_timeout = " + std::to_string(settings.busy_timeout) + ";"
+    );
+    return db;
+}
+
+// Runs an operation under the retry policy, recording its latency including
+// any retries, returns false if it still failed
+template<typename Operation>
+bool attempt(
+        const options &settings,
+        Operation operation,
+        std::vector<std::chrono::nanoseconds> &latencies,
+        uint64_t &busy,
+        uint64_t &errors
+) {
+    auto started(clock_type::now());
+    auto backoff(std::chrono::microseconds(500));
+    for (int attempt(0); ; ++attempt) {
+        try {
+            operation();
+            latencies.push_back(clock_type::now() - started);
+            return true;
+        } catch (const sqlite::transaction_failed &) {
+            ++busy;
+            if (attempt >= settings.retries)
+                return false;
+            std::this_thread::sleep_for(backoff);
+            backoff *= 2;
+        } catch (const sqlite::error &) {
+            ++errors;
+            return false;
+        }
+    }
+}
+
+void read_load(const options &settings, const clock_type::time_point &until, outcome &result) {
+    auto db(open_connection(settings));
+    auto lookup(db.prepare_statement("SELECT value, version FROM kv WHERE id = ?;"));
+    std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<int> ids(1, settings.rows);
+    while (clock_type::now() < until) {
+        lookup.bind(1, ids(random));
+        (void) attempt(settings, [&] {
+            auto rows(db.execute(lookup));
+            for (const sqlite::row &row : rows)
+                (void) row[1].as<int>();
+        }, result.reads, result.busy, result.errors);
+    }
+}
+
+void write_load(const options &settings, const clock_type::time_point &until, outcome &result) {
+    auto db(open_connection(settings));
+    auto update(db.prepare_statement(
+        "UPDATE kv SET value = ?, version = version + 1 WHERE id = ?;"
+    ));
+    std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<int> ids(1, settings.rows);
+    std::string value("updated value");
+    while (clock_type::now() < until) {
+        (void) attempt(settings, [&] {
+            sqlite::as_transaction(db, [&](sqlite::database &db) {
+                for (int i(0); i < settings.batch; ++i) {
+                    update.bind(1, value);
+                    update.bind(2, ids(random));
+                    (void) db.exec(update);
+                }
+            });
+        }, result.writes, result.busy, result.errors);
+    }
+}
+
+outcome run_process(const options &settings) {
+    auto until(clock_type::now() + std::chrono::duration_cast<clock_type::duration>(
+        std::chrono::duration<double>(settings.seconds)
+    ));
+    std::vector<outcome> outcomes(settings.readers + settings.writers);
+    std::vector<std::thread> threads;
+    for (int i(0); i < settings.readers; ++i)
+        threads.emplace_back(read_load, std::cref(settings), until, std::ref(outcomes[i]));
+    for (int i(0); i < settings.writers; ++i) {
+        threads.emplace_back(
+            write_load, std::cref(settings), until,
+            std::ref(outcomes[settings.readers + i])
+        );
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    outcome total;
+    for (const outcome &part : outcomes)
+        total.merge(part);
+    return total;
+}
+
+void write_all(int fd, const void *data, std::size_t size) {
+    auto bytes(static_cast<const char *>(data));
+    while (size) {
+        auto written(::write(fd, bytes, size));
+        if (written <= 0)
+            std::_Exit(1);
+        bytes += written;
+        size -= written;
+    }
+}
+
+bool read_all(int fd, void *data, std::size_t size) {
+    auto bytes(static_cast<char *>(data));
+    while (size) {
+        auto received(::read(fd, bytes, size));
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+void send_samples(int fd, const std::vector<std::chrono::nanoseconds> &samples) {
+    uint64_t count(samples.size());
+    write_all(fd, &count, sizeof(count));
+    for (const std::chrono::nanoseconds &sample : samples) {
+        int64_t nanoseconds(sample.count());
+        write_all(fd, &nanoseconds, sizeof(nanoseconds));
+    }
+}
+
+bool receive_samples(int fd, std::vector<std::chrono::nanoseconds> &samples) {
+    uint64_t count;
+    if (! read_all(fd, &count, sizeof(count)))
+        return false;
+    for (uint64_t i(0); i < count; ++i) {
+        int64_t nanoseconds;
+        if (! read_all(fd, &nanoseconds, sizeof(nanoseconds)))
+            return false;
+        samples.push_back(std::chrono::nanoseconds(nanoseconds));
+    }
+    return true;
+}
+
+// Connections must never cross a fork, so each child opens its own after
+// the parent has closed the database it used for setup
+outcome run_processes(const options &settings) {
+    std::vector<std::pair<pid_t, int>> children;
+    for (int i(0); i < settings.processes; ++i) {
+        int pipe_fds[2];
+        if (::pipe(pipe_fds) != 0)
+            throw sqlite::error("unable to create a pipe to a worker process");
+        pid_t child(::fork());
+        if (child < 0)
+            throw sqlite::error("unable to start a worker process");
+        if (child == 0) {
+            ::close(pipe_fds[0]);
+            int status(0);
+            try {
+                auto result(run_process(settings));
+                send_samples(pipe_fds[1], result.reads);
+                send_samples(pipe_fds[1], result.writes);
+                write_all(pipe_fds[1], &result.busy, sizeof(result.busy));
+                write_all(pipe_fds[1], &result.errors, sizeof(result.errors));
+            } catch (const std::exception &failure) {
+                std::cerr << "sqlite_stress worker: " << failure.what() << "\n";
+                status = 1;
+            }
+            ::close(pipe_fds[1]);
+            std::_Exit(status);
+        }
+        ::close(pipe_fds[1]);
+        children.emplace_back(child, pipe_fds[0]);
+    }
+    outcome total;
+    bool complete(true);
+    for (const auto &child : children) {
+        outcome result;
+        complete = receive_samples(child.second, result.reads)
+            && receive_samples(child.second, result.writes)
+            && read_all(child.second, &result.busy, sizeof(result.busy))
+            && read_all(child.second, &result.errors, sizeof(result.errors))
+            && complete;
+        ::close(child.second);
+        int status;
+        (void) ::waitpid(child.first, &status, 0);
+        total.merge(result);
+    }
+    if (! complete)
+        throw sqlite::error("a worker process failed");
+    return total;
+}
+
+void report(const char *label, const std::vector<std::chrono::nanoseconds> &samples, const double &seconds) {
+    auto latency(sqlite::summarise(samples));
+    auto microseconds([](const std::chrono::nanoseconds &duration) {
+        return duration.count() / 1000.0;
+    });
+    std::cout << std::left << std::setw(8) << label << std::right
+              << std::setw(12) << latency.count / seconds
+              << std::setw(12) << microseconds(latency.p50)
+              << std::setw(12) << microseconds(latency.p99)
+              << std::setw(12) << microseconds(latency.p999)
+              << std::setw(12) << microseconds(latency.max) << "\n";
+}
+
+}
+
+int main(int argc, char *argv[]) try {
+    auto settings(parse_options(argc, argv));
+    prepare_database(settings);
+    auto result(
+        settings.processes > 1 ? run_processes(settings) : run_process(settings)
+    );
+    std::cout << std::fixed << std::setprecision(1)
+              << settings.processes << " process(es) x " << settings.readers
+              << " reader(s) + " << settings.writers << " writer(s), journal_mode="
+              << settings.journal_mode << ", busy_timeout=" << settings.busy_timeout
+              << "ms, retries=" << settings.retries << "\n"
+              << std::left << std::setw(8) << "" << std::right
+              << std::setw(12) << "ops/sec" << std::setw(12) << "p50 us"
+              << std::setw(12) << "p99 us" << std::setw(12) << "p999 us"
+              << std::setw(12) << "max us" << "\n";
+    report("reads", result.reads, settings.seconds);
+    report("writes", result.writes, settings.seconds);
+    std::cout << "transaction_failed " << result.busy
+              << ", other errors " << result.errors << "\n";
+    return result.errors ? 1 : 0;
+} catch (const std::exception &failure) {
+    std::cerr << "sqlite_stress: " << failure.what() << "\n";
+    return 2;
+}
@@ -0,0 +1,207 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "value.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+namespace sqlite {
+
+value::value(const int64_t &integer):
+    kind(value_type::integer), integer(integer) {}
+
+value::value(const double &real): kind(value_type::real), real(real) {}
+
+value::value(const std::string &text): kind(value_type::text), bytes(text) {}
+
+value::value(const value_type &type, const void *data, const std::size_t &size):
+        kind(type) {
+    assert(
+        (type == value_type::text || type == value_type::blob) &&
+        "only text and blob values are built from raw bytes"
+    );
+    bytes.assign(static_cast<const char *>(data), size);
+}
+
+void value::assign_column(sqlite3_stmt *stmt, const int &index) {
+    assert(stmt && "received null sqlite3_stmt");
+    switch (sqlite3_column_type(stmt, index)) {
+    case SQLITE_INTEGER:
+        kind = value_type::integer;
+        integer = sqlite3_column_int64(stmt, index);
+        break;
+    case SQLITE_FLOAT:
+        kind = value_type::real;
+        real = sqlite3_column_double(stmt, index);
+        break;
+    case SQLITE_TEXT:
+        kind = value_type::text;
+        bytes.assign(
+            reinterpret_cast<const char *>(sqlite3_column_text(stmt, index)),
+            sqlite3_column_bytes(stmt, index)
+        );
+        break;
+    case SQLITE_BLOB: {
+        kind = value_type::blob;
+        const char *data(
+            static_cast<const char *>(sqlite3_column_blob(stmt, index))
+        );
+        bytes.assign(data ? data : "", sqlite3_column_bytes(stmt, index));
+        break;
+    }
+    default:
+        kind = value_type::null;
+        break;
+    }
+}
+
+template<>
+int64_t value::as<int64_t>() const {
+    switch (kind) {
+    case value_type::integer: return integer;
+    case value_type::real:    return static_cast<int64_t>(real);
+    case value_type::text:    // fall-through
+    case value_type::blob:    return std::strtoll(bytes.c_str(), nullptr, 10);
+    default:                  return 0;
+    }
+}
+
+template<>
+double value::as<double>() const {
+    switch (kind) {
+    case value_type::integer: return static_cast<double>(integer);
+    case value_type::real:    return real;
+    case value_type::text:    // fall-through
+    case value_type::blob:    return std::strtod(bytes.c_str(), nullptr);
+    default:                  return 0.0;
+    }
+}
+
+template<>
+int value::as<int>() const {
+    return static_cast<int>(as<int64_t>());
+}
+
+template<>
+bool value::as<bool>() const {
+    return as<int64_t>() != 0;
+}
+
+template<>
+std::size_t value::as<std::size_t>() const {
+    return static_cast<std::size_t>(as<int64_t>());
+}
+
+template<>
+std::string value::as<std::string>() const {
+    switch (kind) {
+    case value_type::integer:
+        return std::to_string(integer);
+    case value_type::real: {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.15g", real);
+        std::string formatted(text);
+        if (formatted.find_first_of(".en") == std::string::npos)
+            formatted += ".0";
+        return formatted;
+    }
+    case value_type::text:  // fall-through
+    case value_type::blob:
+        return bytes;
+    default:
+        return "";
+    }
+}
+
+template<>
+char value::as<char>() const {
+    if (kind == value_type::text || kind == value_type::blob)
+        return bytes.empty() ? '\0' : bytes[0];
+    return is_null() ? '\0' : as<std::string>()[0];
+}
+
+bool value::operator==(const value &other) const {
+    if (kind != other.kind)
+        return false;
+    switch (kind) {
+    case value_type::integer: return integer == other.integer;
+    case value_type::real:    return real == other.real;
+    case value_type::text:    // fall-through
+    case value_type::blob:    return bytes == other.bytes;
+    default:                  return true;
+    }
+}
+
+bool value::operator!=(const value &other) const {
+    return ! (*this == other);
+}
+
+value_row::value_row(
+        const std::shared_ptr<const std::vector<std::string>> &column_names,
+        std::vector<value> values
+): names(column_names), values(std::move(values)) {
+    assert(names && names->size() == this->values.size() &&
+           "column names do not match the values provided");
+}
+
+const value& value_row::operator[](const std::string &column_name) const {
+    for (std::size_t i(0); names && i < names->size(); ++i) {
+        if ((*names)[i] == column_name)
+            return values[i];
+    }
+    assert(false && "invalid column name provided");
+    throw error("invalid column name '" + column_name + "'");
+}
+
+const value& value_row::operator[](const std::size_t &column_index) const {
+    assert(column_index < values.size() && "invalid column index requested");
+    if (column_index >= values.size())
+        throw error("no column at index " + std::to_string(column_index));
+    return values[column_index];
+}
+
+void value_row::assign_columns(
+        sqlite3_stmt *stmt,
+        const std::shared_ptr<const std::vector<std::string>> &column_names
+) {
+    names = column_names;
+    values.resize(names->size());
+    for (std::size_t i(0); i < values.size(); ++i)
+        values[i].assign_column(stmt, i);
+}
+
+std::shared_ptr<const std::vector<std::string>> column_names(
+        sqlite3_stmt *stmt
+) {
+    assert(stmt && "received null sqlite3_stmt");
+    std::shared_ptr<std::vector<std::string>> names(
+        std::make_shared<std::vector<std::string>>()
+    );
+    int column_count(sqlite3_column_count(stmt));
+    for (int i(0); i < column_count; ++i) {
+        const char *name(sqlite3_column_name(stmt, i));
+        names->push_back(name ? name : "");
+    }
+    return names;
+}
+
+} // namespace sqlite
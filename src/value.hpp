@@ -0,0 +1,96 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SQLITE_VALUE_H
+#define SQLITE_VALUE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct sqlite3_stmt;
+
+namespace sqlite {
+
+enum class value_type {
+    null,
+    integer,
+    real,
+    text,
+    blob
+};
+
+class value {
+public:
+    value() = default;
+    value(const int64_t &integer);
+    value(const double &real);
+    value(const std::string &text);
+    value(const value_type &type, const void *data, const std::size_t &size);
+
+    value_type type() const { return kind; }
+    bool is_null() const { return kind == value_type::null; }
+    explicit operator bool() const { return ! is_null(); }
+    std::size_t size() const { return bytes.size(); }
+    const char* data() const { return bytes.data(); }
+
+    template<typename T>
+    T as() const;
+
+    void assign_column(sqlite3_stmt *stmt, const int &index);
+
+    bool operator==(const value &other) const;
+    bool operator!=(const value &other) const;
+
+private:
+    value_type kind = value_type::null;
+    int64_t integer = 0;
+    double real = 0.0;
+    std::string bytes;
+};
+
+class value_row {
+public:
+    value_row() = default;
+    value_row(
+            const std::shared_ptr<const std::vector<std::string>> &column_names,
+            std::vector<value> values
+    );
+
+    std::size_t column_count() const { return values.size(); }
+
+    const value& operator[](const std::string &column_name) const;
+    const value& operator[](const std::size_t &column_index) const;
+
+    void assign_columns(
+            sqlite3_stmt *stmt,
+            const std::shared_ptr<const std::vector<std::string>> &column_names
+    );
+
+private:
+    std::shared_ptr<const std::vector<std::string>> names;
+    std::vector<value> values;
+};
+
+std::shared_ptr<const std::vector<std::string>> column_names(
+        sqlite3_stmt *stmt
+);
+
+} // namespace sqlite
+
+#endif // SQLITE_VALUE_H
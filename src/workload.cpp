@@ -0,0 +1,341 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "workload.hpp"
+#include "database.hpp"
+#include "statement.hpp"
+#include "error.hpp"
+
+#include <sqlite3.h>
+
+#include <cmath>
+#include <thread>
+#include <memory>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+namespace sqlite {
+
+namespace {
+
+const char magic[] = {'X', 'X', 'S', 'Q', 'L', 'W', 'L', '1'};
+const char statement_record('S');
+const char event_record('E');
+const std::size_t flush_threshold(64 * 1024);
+
+void put_varint(std::vector<char> &out, uint64_t number) {
+    while (number >= 0x80) {
+        out.push_back(static_cast<char>(number | 0x80));
+        number >>= 7;
+    }
+    out.push_back(static_cast<char>(number));
+}
+
+void put_bytes(std::vector<char> &out, const char *data, const std::size_t &size) {
+    put_varint(out, size);
+    out.insert(out.end(), data, data + size);
+}
+
+void put_value(std::vector<char> &out, const value &parameter) {
+    out.push_back(static_cast<char>(parameter.type()));
+    switch (parameter.type()) {
+    case value_type::integer: {
+        auto integer(parameter.as<int64_t>());
+        put_varint(out, (static_cast<uint64_t>(integer) << 1) ^ (integer < 0 ? ~0ull : 0));
+        break;
+    }
+    case value_type::real: {
+        double real(parameter.as<double>());
+        char bytes[sizeof(real)];
+        std::memcpy(bytes, &real, sizeof(real));
+        out.insert(out.end(), bytes, bytes + sizeof(real));
+        break;
+    }
+    case value_type::text:  // fall-through
+    case value_type::blob:
+        put_bytes(out, parameter.data(), parameter.size());
+        break;
+    case value_type::null:
+        break;
+    }
+}
+
+class log_reader {
+public:
+    log_reader(const std::string &data): data(data), at(0) {}
+
+    bool done() const { return at == data.size(); }
+
+    char tag() {
+        need(1);
+        return data[at++];
+    }
+
+    uint64_t varint() {
+        uint64_t number(0);
+        for (unsigned shift(0); shift < 64; shift += 7) {
+            auto byte(static_cast<unsigned char>(tag()));
+            number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (! (byte & 0x80))
+                return number;
+        }
+        throw error("corrupt varint in workload log");
+    }
+
+    std::string bytes() {
+        auto size(varint());
+        need(size);
+        std::string text(data, at, size);
+        at += size;
+        return text;
+    }
+
+    value parameter() {
+        auto type(static_cast<value_type>(tag()));
+        switch (type) {
+        case value_type::null:
+            return value();
+        case value_type::integer: {
+            auto encoded(varint());
+            return value(static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1));
+        }
+        case value_type::real: {
+            double real;
+            need(sizeof(real));
+            std::memcpy(&real, data.data() + at, sizeof(real));
+            at += sizeof(real);
+            return value(real);
+        }
+        case value_type::text:  // fall-through
+        case value_type::blob: {
+            auto payload(bytes());
+            return value(type, payload.data(), payload.size());
+        }
+        }
+        throw error("corrupt parameter in workload log");
+    }
+
+private:
+    void need(const std::size_t &size) const {
+        if (data.size() - at < size)
+            throw error("truncated workload log");
+    }
+
+private:
+    const std::string &data;
+    std::size_t at;
+};
+
+std::chrono::nanoseconds since(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    );
+}
+
+}   // namespace
+
+namespace detail {
+
+workload_recorder::workload_recorder(sqlite3 *db, const std::string &path):
+    db(db),
+    file(path, std::ios::binary | std::ios::trunc),
+    opened(std::chrono::steady_clock::now()) {
+    if (! file)
+        throw error("unable to open workload log '" + path + "'");
+    buffer.reserve(flush_threshold * 2);
+    buffer.insert(buffer.end(), magic, magic + sizeof(magic));
+    capture_bindings(db);
+}
+
+workload_recorder::~workload_recorder() {
+    release_bindings(db);
+    try {
+        flush();
+    } catch (...) {
+        // Can't throw, called from destructor
+    }
+}
+
+void workload_recorder::started(sqlite3_stmt *stmt) noexcept try {
+    // Triggers report again for the same statement, keep the first start
+    (void) running.emplace(stmt, std::chrono::steady_clock::now());
+} catch (...) {
+    failed = true;
+}
+
+void workload_recorder::record(sqlite3_stmt *stmt) noexcept try {
+    // sqlite's own profile times only have millisecond resolution
+    auto finished(std::chrono::steady_clock::now());
+    auto start(running.find(stmt));
+    if (start == running.end())
+        return;
+    auto began(start->second);
+    running.erase(start);
+    const char *sql(sqlite3_sql(stmt));
+    if (! sql || failed)
+        return;
+    auto found(statement_ids.find(sql));
+    std::size_t id;
+    if (found == statement_ids.end()) {
+        id = statement_ids.size();
+        statement_ids.emplace(sql, id);
+        buffer.push_back(statement_record);
+        put_varint(buffer, id);
+        put_bytes(buffer, sql, std::strlen(sql));
+    } else {
+        id = found->second;
+    }
+    // Parameters bound before recording started are unknown and kept null
+    std::vector<value> values;
+    (void) bound_values(stmt, values);
+    buffer.push_back(event_record);
+    put_varint(buffer, id);
+    put_varint(buffer, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        began - opened
+    ).count());
+    put_varint(buffer, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        finished - began
+    ).count());
+    put_varint(buffer, values.size());
+    for (const value &parameter : values)
+        put_value(buffer, parameter);
+    if (buffer.size() >= flush_threshold)
+        flush();
+} catch (...) {
+    // Can't throw through sqlite
+    failed = true;
+}
+
+void workload_recorder::finish() {
+    flush();
+    file.flush();
+    if (failed || ! file)
+        throw error("failed to write workload log");
+}
+
+void workload_recorder::flush() {
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+    if (! file)
+        failed = true;
+}
+
+} // namespace detail
+
+workload_log read_workload(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (! file)
+        throw error("unable to open workload log '" + path + "'");
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string data(contents.str());
+    if (data.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+        throw error("'" + path + "' is not a workload log");
+    std::string body(data.substr(sizeof(magic)));
+    log_reader reader(body);
+    workload_log log;
+    while (! reader.done()) {
+        char tag(reader.tag());
+        if (tag == statement_record) {
+            auto id(reader.varint());
+            if (id >= log.statements.size())
+                log.statements.resize(id + 1);
+            log.statements[id] = reader.bytes();
+        } else if (tag == event_record) {
+            workload_event event;
+            event.statement = reader.varint();
+            if (event.statement >= log.statements.size())
+                throw error("workload log references an unknown statement");
+            event.offset = std::chrono::nanoseconds(reader.varint());
+            event.duration = std::chrono::nanoseconds(reader.varint());
+            auto count(reader.varint());
+            for (uint64_t i(0); i < count; ++i)
+                event.parameters.push_back(reader.parameter());
+            log.events.push_back(std::move(event));
+        } else {
+            throw error("corrupt record in workload log");
+        }
+    }
+    return log;
+}
+
+latency_distribution summarise(std::vector<std::chrono::nanoseconds> samples) {
+    latency_distribution summary;
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](const double &rank) {
+        auto index(static_cast<std::size_t>(std::ceil(rank * samples.size())));
+        return samples[std::min(samples.size(), std::max<std::size_t>(index, 1)) - 1];
+    };
+    std::chrono::nanoseconds total(0);
+    for (const std::chrono::nanoseconds &sample : samples)
+        total += sample;
+    summary.count = samples.size();
+    summary.min = samples.front();
+    summary.p50 = percentile(0.50);
+    summary.p90 = percentile(0.90);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max = samples.back();
+    summary.mean = total / samples.size();
+    return summary;
+}
+
+std::vector<statement_latency> replay_workload(
+        database &db,
+        const workload_log &log,
+        const replay_pace &pace
+) {
+    std::size_t count(log.statements.size());
+    std::vector<std::unique_ptr<statement>> prepared(count);
+    std::vector<std::vector<std::chrono::nanoseconds>> recorded(count);
+    std::vector<std::vector<std::chrono::nanoseconds>> replayed(count);
+    std::vector<statement_latency> latencies(count);
+    auto start(std::chrono::steady_clock::now());
+    for (const workload_event &event : log.events) {
+        if (pace == replay_pace::original)
+            std::this_thread::sleep_until(start + event.offset);
+        auto &query(prepared[event.statement]);
+        try {
+            // Statements are prepared on first use, as earlier events may
+            // create the schema they depend on
+            if (! query)
+                query.reset(new statement(
+                    db.prepare_statement(log.statements[event.statement])
+                ));
+            query->clear_bindings();
+            for (std::size_t i(0); i < event.parameters.size(); ++i)
+                query->bind(i + 1, event.parameters[i]);
+            auto began(std::chrono::steady_clock::now());
+            (void) db.exec(*query);
+            replayed[event.statement].push_back(since(began));
+            recorded[event.statement].push_back(event.duration);
+        } catch (const error &) {
+            ++latencies[event.statement].failures;
+        }
+    }
+    for (std::size_t i(0); i < count; ++i) {
+        latencies[i].sql = log.statements[i];
+        latencies[i].recorded = summarise(std::move(recorded[i]));
+        latencies[i].replayed = summarise(std::move(replayed[i]));
+    }
+    return latencies;
+}
+
+} // namespace sqlite
@@ -0,0 +1,114 @@
+/*
+   Copyright (C) 2013  Nick Ogden <nick@nickogden.org>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SQLITE_WORKLOAD_H
+#define SQLITE_WORKLOAD_H
+
+#include "value.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <unordered_map>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqlite {
+
+class database;
+
+struct workload_event {
+    std::size_t statement = 0;
+    std::chrono::nanoseconds offset = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds duration = std::chrono::nanoseconds(0);
+    std::vector<value> parameters;
+};
+
+struct workload_log {
+    std::vector<std::string> statements;
+    std::vector<workload_event> events;
+};
+
+workload_log read_workload(const std::string &path);
+
+enum class replay_pace {
+    original,
+    fastest
+};
+
+struct latency_distribution {
+    std::size_t count = 0;
+    std::chrono::nanoseconds min = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds p50 = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds p90 = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds p99 = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds p999 = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds max = std::chrono::nanoseconds(0);
+    std::chrono::nanoseconds mean = std::chrono::nanoseconds(0);
+};
+
+latency_distribution summarise(std::vector<std::chrono::nanoseconds> samples);
+
+struct statement_latency {
+    std::string sql;
+    std::size_t failures = 0;
+    latency_distribution recorded;
+    latency_distribution replayed;
+};
+
+std::vector<statement_latency> replay_workload(
+        database &db,
+        const workload_log &log,
+        const replay_pace &pace = replay_pace::fastest
+);
+
+namespace detail {
+
+class workload_recorder {
+public:
+    workload_recorder(sqlite3 *db, const std::string &path);
+    workload_recorder(const workload_recorder &other) = delete;
+    ~workload_recorder();
+
+    workload_recorder& operator=(const workload_recorder &other) = delete;
+
+    void started(sqlite3_stmt *stmt) noexcept;
+    void record(sqlite3_stmt *stmt) noexcept;
+    void finish();
+
+private:
+    void flush();
+
+private:
+    sqlite3 *db;
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::unordered_map<std::string, std::size_t> statement_ids;
+    std::unordered_map<sqlite3_stmt *, std::chrono::steady_clock::time_point> running;
+    std::chrono::steady_clock::time_point opened;
+    bool failed = false;
+};
+
+} // namespace detail
+
+} // namespace sqlite
+
+#endif // SQLITE_WORKLOAD_H